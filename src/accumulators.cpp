@@ -200,14 +200,8 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint)
         }
 
         //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex)) {
-            LogPrint("zero","%s: failed to read block from disk\n", __func__);
-            return false;
-        }
-
         std::list<PublicCoin> listPubcoins;
-        if (!BlockToPubcoinList(block, listPubcoins)) {
+        if (!BlockIndexToPubcoinList(pindex, listPubcoins)) {
             LogPrint("zero","%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
             return false;
         }
@@ -247,7 +241,76 @@ bool InvalidCheckpointRange(int nHeight)
     return nHeight > Params().Zerocoin_Block_LastGoodCheckpoint() && nHeight < Params().Zerocoin_Block_RecalculateAccumulators();
 }
 
-bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError)
+//! Snapshots past this many checkpoints are only needed for a full witness, so just the latest one is kept
+static const int WITNESS_CHECKPOINTS_MAX = 100;
+
+void CAccumulatorWitnessData::Reset(const CBigNum& bnPubcoin, int nHeightAccStart, const CBigNum& bnAccStartValue)
+{
+    SetNull();
+    this->bnPubcoin = bnPubcoin;
+    this->nHeightAccStart = nHeightAccStart;
+    this->bnAccStartValue = bnAccStartValue;
+}
+
+void CAccumulatorWitnessData::RemoveInvalid()
+{
+    //snapshots are ordered by height, so everything after the first stale snapshot is stale too
+    for (auto it = vCheckpoints.begin(); it != vCheckpoints.end(); ++it) {
+        if (it->nHeight - 1 > chainActive.Height() || chainActive[it->nHeight - 1]->GetBlockHash() != it->hashBlockLast) {
+            vCheckpoints.erase(it, vCheckpoints.end());
+            return;
+        }
+    }
+}
+
+const CWitnessCheckpoint* CAccumulatorWitnessData::GetCheckpoint(int nHeight) const
+{
+    for (auto it = vCheckpoints.rbegin(); it != vCheckpoints.rend(); ++it) {
+        if (it->nHeight <= nHeight)
+            return &(*it);
+    }
+    return NULL;
+}
+
+void CAccumulatorWitnessData::AddCheckpoint(const CWitnessCheckpoint& checkpoint)
+{
+    auto it = vCheckpoints.begin();
+    while (it != vCheckpoints.end() && it->nHeight < checkpoint.nHeight)
+        ++it;
+    if (it != vCheckpoints.end() && it->nHeight == checkpoint.nHeight)
+        *it = checkpoint;
+    else
+        vCheckpoints.insert(it, checkpoint);
+
+    //keep only the latest of the snapshots that are beyond any randomized security level
+    int nBeyondMax = 0;
+    for (const CWitnessCheckpoint& c : vCheckpoints) {
+        if (c.nCheckpointsAdded > WITNESS_CHECKPOINTS_MAX)
+            nBeyondMax++;
+    }
+    for (it = vCheckpoints.begin(); nBeyondMax > 1 && it != vCheckpoints.end();) {
+        if (it->nCheckpointsAdded > WITNESS_CHECKPOINTS_MAX) {
+            it = vCheckpoints.erase(it);
+            nBeyondMax--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+//a new accumulator checkpoint was generated in this block
+static bool IsNewCheckpoint(const CBlockIndex* pindex, int nAccStartHeight)
+{
+    return pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint;
+}
+
+//the witness is complete when reaching this block, and the accumulator is initialized at its checkpoint
+static bool IsWitnessEnd(const CBlockIndex* pindex, int nHeightStop, int nSecurityLevel, int nCheckpointsAdded)
+{
+    return !InvalidCheckpointRange(pindex->nHeight) && (pindex->nHeight == nHeightStop || (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel));
+}
+
+bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CAccumulatorWitnessData* pWitnessData, int nMaxBlocks)
 {
     uint256 txid;
     if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid)) {
@@ -306,6 +369,13 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
         }
     }
 
+    //a persisted witness can only be resumed if it was started from the same accumulator
+    if (pWitnessData) {
+        if (pWitnessData->bnPubcoin != coin.getValue() || pWitnessData->nHeightAccStart != nAccStartHeight || pWitnessData->bnAccStartValue != bnAccValue)
+            pWitnessData->Reset(coin.getValue(), nAccStartHeight, bnAccValue);
+        pWitnessData->RemoveInvalid();
+    }
+
     //security level: this is an important prevention of tracing the coins via timing. Security level represents how many checkpoints
     //of accumulated coins are added *beyond* the checkpoint that the mint being spent was added too. If each spend added the exact same
     //amounts of checkpoints after the mint was accumulated, then you could know the range of blocks that the mint originated from.
@@ -323,15 +393,55 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     int nChainHeight = chainActive.Height();
     int nHeightStop = nChainHeight % 10;
     nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
+
+    //only go nMaxBlocks past the latest snapshot, so that a caller can advance the witness in steps
+    if (nMaxBlocks > 0) {
+        int nHeightResume = pWitnessData && !pWitnessData->vCheckpoints.empty() ? pWitnessData->vCheckpoints.back().nHeight : nAccStartHeight;
+        int nHeightLimit = nHeightResume + nMaxBlocks;
+        nHeightStop = std::min(nHeightStop, nHeightLimit - nHeightLimit % 10);
+    }
     int nCheckpointsAdded = 0;
     nMintsAdded = 0;
+
+    //find the block where the witness will be complete, walking the block index only
+    int nHeightWitnessEnd = nAccStartHeight;
+    while (nHeightWitnessEnd < nHeightStop + 1) {
+        if (IsNewCheckpoint(chainActive[nHeightWitnessEnd], nAccStartHeight))
+            ++nCheckpointsAdded;
+        if (IsWitnessEnd(chainActive[nHeightWitnessEnd], nHeightStop, nSecurityLevel, nCheckpointsAdded))
+            break;
+        ++nHeightWitnessEnd;
+    }
+    nCheckpointsAdded = 0;
+
+    //resume from the latest persisted snapshot of the witness that is not past that block
+    if (pWitnessData) {
+        const CWitnessCheckpoint* pcheckpoint = pWitnessData->GetCheckpoint(nHeightWitnessEnd);
+        if (pcheckpoint) {
+            CBigNum bnAccumulatorPrev = accumulator.getValue();
+            accumulator.setValue(pcheckpoint->bnValue);
+            witness.resetValue(accumulator, coin);
+            accumulator.setValue(bnAccumulatorPrev);
+            nCheckpointsAdded = pcheckpoint->nCheckpointsAdded;
+            nMintsAdded = pcheckpoint->nMintsAdded;
+            pindex = chainActive[pcheckpoint->nHeight];
+            LogPrint("zero", "%s : resuming witness from block %d\n", __func__, pcheckpoint->nHeight);
+        }
+    }
+
     while (pindex->nHeight < nHeightStop + 1) {
-        if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
+        bool fNewCheckpoint = IsNewCheckpoint(pindex, nAccStartHeight);
+
+        //snapshot the witness on entering each checkpoint and the final block so later spends can resume from it
+        if (pWitnessData && pindex->nHeight != nAccStartHeight && (fNewCheckpoint || pindex->nHeight == nHeightWitnessEnd))
+            pWitnessData->AddCheckpoint(CWitnessCheckpoint(pindex->nHeight, pindex->pprev->GetBlockHash(), nCheckpointsAdded, nMintsAdded, witness.getValue()));
+
+        if (fNewCheckpoint)
             ++nCheckpointsAdded;
 
         //if a new checkpoint was generated on this block, and we have added the specified amount of checkpointed accumulators,
         //then initialize the accumulator at this point and break
-        if (!InvalidCheckpointRange(pindex->nHeight) && (pindex->nHeight == nHeightStop || (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel))) {
+        if (IsWitnessEnd(pindex, nHeightStop, nSecurityLevel, nCheckpointsAdded)) {
             uint32_t nChecksum = ParseChecksum(chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint, coin.getDenomination());
             CBigNum bnAccValue = 0;
             if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnAccValue)) {
@@ -344,15 +454,9 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
 
         // if this block contains mints of the denomination that is being spent, then add them to the witness
         if (pindex->MintedDenomination(coin.getDenomination())) {
-            //grab mints from this block
-            CBlock block;
-            if(!ReadBlockFromDisk(block, pindex)) {
-                LogPrintf("%s: failed to read block from disk while adding pubcoins to witness\n", __func__);
-                return false;
-            }
-
+            //grab mints of this denomination from this block
             list<PublicCoin> listPubcoins;
-            if(!BlockToPubcoinList(block, listPubcoins)) {
+            if(!BlockIndexToPubcoinList(pindex, listPubcoins, coin.getDenomination())) {
                 LogPrintf("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
                 return false;
             }
@@ -389,4 +493,16 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
 
     LogPrint("zero","%s : %d mints added to witness\n", __func__, nMintsAdded);
     return true;
+}
+
+bool AdvanceAccumulatorWitness(const PublicCoin& coin, CAccumulatorWitnessData& witnessData, int nMaxBlocks)
+{
+    //a full security level witness passes every checkpoint up to the chain tip, snapshotting along the way
+    Accumulator accumulator(Params().Zerocoin_Params(), coin.getDenomination());
+    AccumulatorWitness witness(Params().Zerocoin_Params(), accumulator, coin);
+    int nMintsAdded = 0;
+    string strError;
+    GenerateAccumulatorWitness(coin, accumulator, witness, 100, nMintsAdded, strError, &witnessData, nMaxBlocks);
+
+    return !witnessData.IsNull();
 }
\ No newline at end of file
@@ -9,9 +9,103 @@
 #include "libzerocoin/Denominations.h"
 #include "libzerocoin/Coin.h"
 #include "primitives/zerocoin.h"
+#include "serialize.h"
 #include "uint256.h"
 
-bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError);
+#include <vector>
+
+/**
+ * Snapshot of an accumulator witness on its way to the chain tip: the witness value
+ * once all pubcoins of the denomination in blocks [nHeightAccStart, nHeight) are added.
+ */
+class CWitnessCheckpoint
+{
+public:
+    int nHeight;
+    uint256 hashBlockLast; // hash of the block at nHeight - 1, to detect reorgs
+    int nCheckpointsAdded;
+    int nMintsAdded;
+    CBigNum bnValue;
+
+    CWitnessCheckpoint()
+    {
+        nHeight = 0;
+        hashBlockLast = 0;
+        nCheckpointsAdded = 0;
+        nMintsAdded = 0;
+        bnValue = 0;
+    }
+
+    CWitnessCheckpoint(int nHeight, const uint256& hashBlockLast, int nCheckpointsAdded, int nMintsAdded, const CBigNum& bnValue)
+    {
+        this->nHeight = nHeight;
+        this->hashBlockLast = hashBlockLast;
+        this->nCheckpointsAdded = nCheckpointsAdded;
+        this->nMintsAdded = nMintsAdded;
+        this->bnValue = bnValue;
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nHeight);
+        READWRITE(hashBlockLast);
+        READWRITE(nCheckpointsAdded);
+        READWRITE(nMintsAdded);
+        READWRITE(bnValue);
+    };
+};
+
+/**
+ * Persistent accumulator witness of one mint. The wallet keeps one per unspent mint and
+ * advances it as blocks connect, so a spend only has to add the last few checkpoints' pubcoins.
+ */
+class CAccumulatorWitnessData
+{
+public:
+    CBigNum bnPubcoin;
+    int nHeightAccStart;
+    CBigNum bnAccStartValue;
+    std::vector<CWitnessCheckpoint> vCheckpoints;
+
+    CAccumulatorWitnessData()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        bnPubcoin = 0;
+        nHeightAccStart = 0;
+        bnAccStartValue = 0;
+        vCheckpoints.clear();
+    }
+
+    bool IsNull() const { return bnPubcoin == 0; }
+
+    /** Start over from the accumulator value the witness of bnPubcoin is initialized with */
+    void Reset(const CBigNum& bnPubcoin, int nHeightAccStart, const CBigNum& bnAccStartValue);
+    /** Drop the snapshots that are no longer on the active chain */
+    void RemoveInvalid();
+    /** @return the latest snapshot at or below nHeight, or NULL */
+    const CWitnessCheckpoint* GetCheckpoint(int nHeight) const;
+    void AddCheckpoint(const CWitnessCheckpoint& checkpoint);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(bnPubcoin);
+        READWRITE(nHeightAccStart);
+        READWRITE(bnAccStartValue);
+        READWRITE(vCheckpoints);
+    };
+};
+
+bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CAccumulatorWitnessData* pWitnessData = NULL, int nMaxBlocks = 0);
+/** Advance the persisted witness towards the tip, by at most nMaxBlocks past its latest snapshot if nMaxBlocks > 0 */
+bool AdvanceAccumulatorWitness(const libzerocoin::PublicCoin& coin, CAccumulatorWitnessData& witnessData, int nMaxBlocks = 0);
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
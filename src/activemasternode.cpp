@@ -309,8 +309,9 @@ bool CActiveMasternode::Register(CTxIn vin, CService service, CKey keyCollateral
     if (pmn == NULL) {
         CMasternode mn(mnb);
         mnodeman.Add(mn);
-    } else {
-        pmn->UpdateFromNewBroadcast(mnb);
+    } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+        mnodeman.RebuildIndexes();
+        mnodeman.ClearRankTables();
     }
 
     //send to all peers
@@ -7,6 +7,8 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "memusage.h"
+#include "poolalloc.h"
 #include "script/standard.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -283,6 +285,15 @@ public:
                 return false;
         return true;
     }
+
+    //! Heap memory held by the outputs and their scripts
+    size_t DynamicMemoryUsage() const
+    {
+        size_t ret = memusage::DynamicUsage(vout);
+        BOOST_FOREACH (const CTxOut& out, vout)
+            ret += memusage::DynamicUsage(*static_cast<const std::vector<unsigned char>*>(&out.scriptPubKey));
+        return ret;
+    }
 };
 
 class CCoinsKeyHasher
@@ -316,7 +327,8 @@ struct CCoinsCacheEntry {
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>,
+    pool_allocator<std::pair<const uint256, CCoinsCacheEntry> > > CCoinsMap;
 
 struct CCoinsStats {
     int nHeight;
@@ -398,7 +410,8 @@ class CCoinsModifier
 private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
-    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_);
+    size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
     CCoins* operator->() { return &it->second.coins; }
@@ -419,8 +432,12 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    mutable CNodePool poolCoins; // Backs the nodes of cacheCoins, released on Flush
     mutable CCoinsMap cacheCoins;
 
+    /* Cached dynamic memory usage for the inner CCoins objects. */
+    mutable size_t cachedCoinsUsage;
+
 public:
     CCoinsViewCache(CCoinsView* baseIn);
     ~CCoinsViewCache();
@@ -456,6 +473,9 @@ public:
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
     /** 
      * Amount of BitMoney coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
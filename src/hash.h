@@ -40,63 +40,6 @@
 using namespace std;
 typedef uint256 ChainCode;
 
-#ifdef GLOBALDEFINED
-#define GLOBAL
-#else
-#define GLOBAL extern
-#endif
-
-GLOBAL sph_blake512_context     z_blake;
-GLOBAL sph_bmw512_context       z_bmw;
-GLOBAL sph_groestl512_context   z_groestl;
-GLOBAL sph_jh512_context        z_jh;
-GLOBAL sph_keccak512_context    z_keccak;
-GLOBAL sph_skein512_context     z_skein;
-GLOBAL sph_luffa512_context     z_luffa;
-GLOBAL sph_cubehash512_context  z_cubehash;
-GLOBAL sph_shavite512_context   z_shavite;
-GLOBAL sph_simd512_context      z_simd;
-GLOBAL sph_echo512_context      z_echo;
-GLOBAL sph_hamsi512_context     z_hamsi;
-GLOBAL sph_fugue512_context     z_fugue;
-GLOBAL sph_shabal512_context    z_shabal;
-GLOBAL sph_whirlpool_context    z_whirlpool;
-GLOBAL sph_sha512_context       z_sha2;
-GLOBAL sph_haval256_5_context   z_haval;
-
-#define fillz() do { \
-    sph_blake512_init(&z_blake); \
-    sph_bmw512_init(&z_bmw); \
-    sph_groestl512_init(&z_groestl); \
-    sph_jh512_init(&z_jh); \
-    sph_keccak512_init(&z_keccak); \
-    sph_skein512_init(&z_skein); \
-    sph_luffa512_init(&z_luffa); \
-    sph_cubehash512_init(&z_cubehash); \
-    sph_shavite512_init(&z_shavite); \
-    sph_simd512_init(&z_simd); \
-    sph_echo512_init(&z_echo); \
-    sph_hamsi512_init(&z_hamsi); \
-    sph_fugue512_init(&z_fugue); \
-    sph_shabal512_init(&z_shabal); \
-    sph_whirlpool_init(&z_whirlpool); \
-    sph_sha512_init(&z_sha2); \
-    sph_haval256_5_init(&z_haval); \
-} while (0) 
-
-#define ZBLAKE (memcpy(&ctx_blake, &z_blake, sizeof(z_blake)))
-#define ZBMW (memcpy(&ctx_bmw, &z_bmw, sizeof(z_bmw)))
-#define ZGROESTL (memcpy(&ctx_groestl, &z_groestl, sizeof(z_groestl)))
-#define ZJH (memcpy(&ctx_jh, &z_jh, sizeof(z_jh)))
-#define ZKECCAK (memcpy(&ctx_keccak, &z_keccak, sizeof(z_keccak)))
-#define ZSKEIN (memcpy(&ctx_skein, &z_skein, sizeof(z_skein)))
-#define ZHAMSI (memcpy(&ctx_hamsi, &z_hamsi, sizeof(z_hamsi)))
-#define ZFUGUE (memcpy(&ctx_fugue, &z_fugue, sizeof(z_fugue)))
-#define ZSHABAL (memcpy(&ctx_shabal, &z_shabal, sizeof(z_shabal)))
-#define ZWHIRLPOOL (memcpy(&ctx_whirlpool, &z_whirlpool, sizeof(z_whirlpool)))
-#define ZSHA2 (memcpy(&ctx_sha2, &z_sha2, sizeof(z_sha2)))
-#define ZHAVAL (memcpy(&ctx_haval, &z_haval, sizeof(z_haval)))
-
 /** A hasher class for Bitcoin's 256-bit hash (double SHA-256). */
 class CHash256
 {
@@ -291,6 +234,11 @@ void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned
 //int HMAC_SHA512_Update(HMAC_SHA512_CTX *pctx, const void *pdata, size_t len);
 //int HMAC_SHA512_Final(unsigned char *pmd, HMAC_SHA512_CTX *pctx);
 
+/**
+ * XEVAN: two rounds of the 17 sph hash functions over a 128 byte work size.
+ * All hashing contexts live on the caller's stack, so it is safe to hash
+ * headers from several threads at once (see GetBlockHeaderHashes).
+ */
 template<typename T1>
 inline uint256 XEVAN(const T1 pbegin, const T1 pend)
 {
@@ -312,7 +260,7 @@ inline uint256 XEVAN(const T1 pbegin, const T1 pend)
     sph_whirlpool_context     ctx_whirlpool;
     sph_sha512_context        ctx_sha2;
     sph_haval256_5_context    ctx_haval;
-static unsigned char pblank[1];
+    static const unsigned char pblank[1] = {};
 
 #ifndef QT_NO_DEBUG
     //std::string strhash;
@@ -28,6 +28,7 @@
 #include "miner.h"
 #include "net.h"
 #include "rpcserver.h"
+#include "script/sigcache.h"
 #include "script/standard.h"
 #include "spork.h"
 #include "sporkdb.h"
@@ -338,6 +339,7 @@ std::string HelpMessage(HelpMessageMode mode)
 #endif
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-reindexaccumulators", _("Reindex the accumulator database") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-reindexzerocoin", _("Rebuild the zerocoin pubcoin index from the blk000??.dat files") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-reindexmoneysupply", _("Reindex the BitMoney and zBIT money supply statistics") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
 #if !defined(WIN32)
@@ -360,6 +362,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", _("Wait for socket events with 'epoll' or 'select' (default: epoll where available, otherwise select)"));
+    strUsage += HelpMessageOpt("-netprofileinterval=<n>", _("Write per command message statistics (see getnetprofile) to debug.log every <n> seconds (default: 0, disabled)"));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
@@ -453,7 +457,7 @@ std::string HelpMessage(HelpMessageMode mode)
     if (GetBoolArg("-help-debug", false)) {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in BitMoney/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-printtoconsole", strprintf(_("Send trace/debug info to console instead of debug.log file (default: %u)"), 0));
@@ -795,7 +799,10 @@ bool AppInit2(boost::thread_group& threadGroup)
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", 125);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    // select() cannot watch descriptors at or above FD_SETSIZE, epoll has no such limit
+    if (!UseSocketEventsEpoll())
+        nMaxConnections = std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
+    nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -962,10 +969,12 @@ bool AppInit2(boost::thread_group& threadGroup)
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and zerocoin spend verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadZerocoinSpendCheck);
     }
 
     if (mapArgs.count("-sporkkey")) // spork priv key
@@ -1300,7 +1309,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     nTotalCache -= nBlockTreeDBCache;
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
-    nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
+    nCoinCacheUsage = nTotalCache; // the coins cache accounts for its own memory usage
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1357,13 +1366,30 @@ bool AppInit2(boost::thread_group& threadGroup)
                     break;
                 }
 
-                // Recalculate money supply for blocks that are impacted by accounting issue after zerocoin activation
-                if (GetBoolArg("-reindexmoneysupply", false)) {
-                    if (chainActive.Height() >= Params().Zerocoin_AccumulatorStartHeight()) {
-                        RecalculateZBitMoneyMinted();
-                        RecalculateZBitMoneySpent();
+                // Backfill the zerocoin pubcoin index for blocks connected before it existed
+                if (GetBoolArg("-reindexzerocoin", false)) {
+                    uiInterface.InitMessage(_("Indexing zerocoin mints..."));
+                    if (!ReindexZerocoinPubcoins()) {
+                        strLoadError = _("Error indexing zerocoin mints");
+                        break;
+                    }
+                }
+
+                // Recalculate money supply for blocks that are impacted by accounting issue after zerocoin activation,
+                // or finish a recalculation that was interrupted
+                int nHeightSupplyDone = 0;
+                if (GetBoolArg("-reindexmoneysupply", false) || pblocktree->ReadMoneySupplyProgress(nHeightSupplyDone)) {
+                    uiInterface.InitMessage(_("Recalculating money supply..."));
+                    int nHeightSupplyStart = 1;
+                    if (nHeightSupplyDone > 0 && nHeightSupplyDone < chainActive.Height()) {
+                        LogPrintf("Resuming money supply recalculation after block %d\n", nHeightSupplyDone);
+                        nHeightSupplyStart = nHeightSupplyDone + 1;
+                    }
+                    // An interrupted run is picked up again on the next start
+                    if (!RecalculateMoneySupply(nHeightSupplyStart) && !ShutdownRequested()) {
+                        strLoadError = _("Error recalculating money supply");
+                        break;
                     }
-                    RecalculateBitMoneySupply(1);
                 }
 
                 // Force recalculation of accumulators.
@@ -1832,6 +1858,8 @@ bool AppInit2(boost::thread_group& threadGroup)
     if (GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup);
 
+    // Charge cs_main waits in message handlers to the network profile
+    WatchLockWait(&cs_main);
     StartNode(threadGroup);
 
 #ifdef ENABLE_WALLET
@@ -1852,6 +1880,9 @@ bool AppInit2(boost::thread_group& threadGroup)
 
         // Run a thread to flush wallet periodically
         threadGroup.create_thread(boost::bind(&ThreadFlushWalletDB, boost::ref(pwalletMain->strWalletFile)));
+
+        // Advance the accumulator witnesses of our mints off the block processing thread
+        threadGroup.create_thread(boost::bind(&ThreadUpdateAccumulatorWitnesses, pwalletMain));
     }
 #endif
 
@@ -6,9 +6,13 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <atomic>
+
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
+#include "crypto/common.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
@@ -73,37 +77,29 @@ static int64_t GetStakeModifierSelectionInterval()
     return nSelectionInterval;
 }
 
-// select a block from the candidate blocks in vSortedByTimestamp, excluding
-// already selected blocks in vSelectedBlocks, and with timestamp up to
-// nSelectionIntervalStop.
-static bool SelectBlockFromCandidates(
-    vector<pair<int64_t, uint256> >& vSortedByTimestamp,
-    map<uint256, const CBlockIndex*>& mapSelectedBlocks,
-    int64_t nSelectionIntervalStop,
-    uint64_t nStakeModifierPrev,
-    const CBlockIndex** pindexSelected)
-{
-    bool fModifierV2 = false;
-    bool fFirstRun = true;
-    bool fSelected = false;
-    uint256 hashBest = 0;
-    *pindexSelected = (const CBlockIndex*)0;
-    BOOST_FOREACH (const PAIRTYPE(int64_t, uint256) & item, vSortedByTimestamp) {
-        if (!mapBlockIndex.count(item.second))
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
-            break;
+/** A block in the selection interval of ComputeNextStakeModifier() */
+struct CModifierCandidate {
+    int64_t nTime;
+    const CBlockIndex* pindex;
+    uint256 hashSelection;
+    bool fSelected;
 
-        //if the lowest block height (vSortedByTimestamp[0]) is >= switch height, use new modifier calc
-        if (fFirstRun){
-            fModifierV2 = pindex->nHeight >= Params().ModifierUpgradeBlock();
-            fFirstRun = false;
-        }
+    bool operator<(const CModifierCandidate& other) const
+    {
+        if (nTime != other.nTime)
+            return nTime < other.nTime;
+        return pindex->GetBlockHash() < other.pindex->GetBlockHash();
+    }
+};
 
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
-            continue;
+// compute the selection hash of every candidate once, it only depends on the
+// block and the previous stake modifier
+static void ComputeSelectionHashes(vector<CModifierCandidate>& vCandidates, uint64_t nStakeModifierPrev)
+{
+    //if the lowest block height (vCandidates[0]) is >= switch height, use new modifier calc
+    bool fModifierV2 = !vCandidates.empty() && vCandidates[0].pindex->nHeight >= Params().ModifierUpgradeBlock();
+    for (CModifierCandidate& candidate : vCandidates) {
+        const CBlockIndex* pindex = candidate.pindex;
 
         // compute the selection hash by hashing an input that is unique to that block
         uint256 hashProof;
@@ -114,21 +110,41 @@ static bool SelectBlockFromCandidates(
 
         CDataStream ss(SER_GETHASH, 0);
         ss << hashProof << nStakeModifierPrev;
-        uint256 hashSelection = Hash(ss.begin(), ss.end());
+        candidate.hashSelection = Hash(ss.begin(), ss.end());
 
         // the selection hash is divided by 2**32 so that proof-of-stake block
         // is always favored over proof-of-work block. this is to preserve
         // the energy efficiency property
         if (pindex->IsProofOfStake())
-            hashSelection >>= 32;
+            candidate.hashSelection >>= 32;
+    }
+}
+
+// select a block from the candidate blocks in vCandidates (sorted by timestamp),
+// excluding already selected blocks, and with timestamp up to
+// nSelectionIntervalStop.
+static bool SelectBlockFromCandidates(
+    vector<CModifierCandidate>& vCandidates,
+    int64_t nSelectionIntervalStop,
+    CModifierCandidate** pcandidateSelected)
+{
+    bool fSelected = false;
+    uint256 hashBest = 0;
+    *pcandidateSelected = NULL;
+    for (CModifierCandidate& candidate : vCandidates) {
+        if (fSelected && candidate.nTime > nSelectionIntervalStop)
+            break;
 
-        if (fSelected && hashSelection < hashBest) {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+        if (candidate.fSelected)
+            continue;
+
+        if (fSelected && candidate.hashSelection < hashBest) {
+            hashBest = candidate.hashSelection;
+            *pcandidateSelected = &candidate;
         } else if (!fSelected) {
             fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+            hashBest = candidate.hashSelection;
+            *pcandidateSelected = &candidate;
         }
     }
     if (GetBoolArg("-printstakemodifier", false))
@@ -177,38 +193,45 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         return true;
 
     // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256> > vSortedByTimestamp;
-    vSortedByTimestamp.reserve(64 * getIntervalVersion(fTestNet) / nStakeTargetSpacing);
+    static thread_local vector<CModifierCandidate> vCandidates;
+    vCandidates.clear();
+    vCandidates.reserve(64 * getIntervalVersion(fTestNet) / nStakeTargetSpacing);
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval();
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / getIntervalVersion(fTestNet)) * getIntervalVersion(fTestNet) - nSelectionInterval;
     const CBlockIndex* pindex = pindexPrev;
 
     while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
+        CModifierCandidate candidate;
+        candidate.nTime = pindex->GetBlockTime();
+        candidate.pindex = pindex;
+        candidate.fSelected = false;
+        vCandidates.push_back(candidate);
         pindex = pindex->pprev;
     }
 
     int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
+    reverse(vCandidates.begin(), vCandidates.end());
+    sort(vCandidates.begin(), vCandidates.end());
+    ComputeSelectionHashes(vCandidates, nStakeModifier);
 
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
-    for (int nRound = 0; nRound < min(64, (int)vSortedByTimestamp.size()); nRound++) {
+    for (int nRound = 0; nRound < min(64, (int)vCandidates.size()); nRound++) {
         // add an interval section to the current selection round
         nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
 
         // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+        CModifierCandidate* pcandidate = NULL;
+        if (!SelectBlockFromCandidates(vCandidates, nSelectionIntervalStop, &pcandidate))
             return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
+        pindex = pcandidate->pindex;
 
         // write the entropy bit of the selected block
         nStakeModifierNew |= (((uint64_t)pindex->GetStakeEntropyBit()) << nRound);
 
         // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
+        pcandidate->fSelected = true;
         if (fDebug || GetBoolArg("-printstakemodifier", false))
             LogPrintf("ComputeNextStakeModifier: selected round %d stop=%s height=%d bit=%d\n",
                 nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), pindex->nHeight, pindex->GetStakeEntropyBit());
@@ -226,10 +249,12 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
             pindex = pindex->pprev;
         }
-        BOOST_FOREACH (const PAIRTYPE(uint256, const CBlockIndex*) & item, mapSelectedBlocks) {
+        for (const CModifierCandidate& candidate : vCandidates) {
+            if (!candidate.fSelected)
+                continue;
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, item.second->IsProofOfStake() ? "S" : "W");
+            strSelectionMap.replace(candidate.pindex->nHeight - nHeightFirstCandidate, 1, candidate.pindex->IsProofOfStake() ? "S" : "W");
         }
         LogPrintf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap.c_str());
     }
@@ -242,38 +267,99 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     return true;
 }
 
+/** Where the kernel stake modifier of a block-from was found, see GetKernelStakeModifier() */
+struct CKernelModifierEntry {
+    const CBlockIndex* pindexFrom;
+    //! Last block generating a modifier within the selection interval
+    const CBlockIndex* pindexModifier;
+    //! Block whose modifier is used
+    const CBlockIndex* pindexEnd;
+};
+
+static CCriticalSection cs_kernelModifiers;
+//! Kernel stake modifiers of the active chain indexed by block-from height
+static std::vector<CKernelModifierEntry> vKernelModifiers;
+
 // The stake modifier used to hash for a stake kernel is chosen as the stake
 // modifier about a selection interval later than the coin generating the kernel
-bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+static bool FindKernelStakeModifier(const CBlockIndex* pindexFrom, CKernelModifierEntry& entry)
 {
-    nStakeModifier = 0;
-    if (!mapBlockIndex.count(hashBlockFrom))
-        return error("GetKernelStakeModifier() : block not indexed");
-    const CBlockIndex* pindexFrom = mapBlockIndex[hashBlockFrom];
-    nStakeModifierHeight = pindexFrom->nHeight;
-    nStakeModifierTime = pindexFrom->GetBlockTime();
+    entry.pindexFrom = pindexFrom;
+    entry.pindexModifier = pindexFrom;
+    int64_t nStakeModifierTime = pindexFrom->GetBlockTime();
     int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
     const CBlockIndex* pindex = pindexFrom;
     CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
 
     // loop to find the stake modifier later by a selection interval
     while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval) {
-        if (!pindexNext) {
-            // Should never happen
-            return error("Null pindexNext\n");
-        }
+        if (!pindexNext)
+            return false;
 
         pindex = pindexNext;
         pindexNext = chainActive[pindexNext->nHeight + 1];
         if (pindex->GeneratedStakeModifier()) {
-            nStakeModifierHeight = pindex->nHeight;
+            entry.pindexModifier = pindex;
             nStakeModifierTime = pindex->GetBlockTime();
         }
     }
-    nStakeModifier = pindex->nStakeModifier;
+    entry.pindexEnd = pindex;
     return true;
 }
 
+// An entry stays valid as long as the block whose modifier it uses is in the active chain
+static bool IsKernelModifierValid(const CKernelModifierEntry& entry, const CBlockIndex* pindexFrom)
+{
+    return entry.pindexFrom == pindexFrom && chainActive[entry.pindexEnd->nHeight] == entry.pindexEnd;
+}
+
+bool GetKernelStakeModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+{
+    nStakeModifier = 0;
+    CKernelModifierEntry entry;
+    {
+        LOCK(cs_kernelModifiers);
+        const int nHeight = pindexFrom->nHeight;
+        if (nHeight < (int)vKernelModifiers.size() && IsKernelModifierValid(vKernelModifiers[nHeight], pindexFrom)) {
+            entry = vKernelModifiers[nHeight];
+        } else {
+            if (!FindKernelStakeModifier(pindexFrom, entry)) {
+                // Should never happen
+                return error("Null pindexNext\n");
+            }
+            if (nHeight < (int)vKernelModifiers.size() && chainActive.Contains(pindexFrom))
+                vKernelModifiers[nHeight] = entry;
+        }
+    }
+
+    nStakeModifierHeight = entry.pindexModifier->nHeight;
+    nStakeModifierTime = entry.pindexModifier->GetBlockTime();
+    nStakeModifier = entry.pindexEnd->nStakeModifier;
+    return true;
+}
+
+//! Bumped on every new tip, stake searches started on an older tip stop early
+static std::atomic<unsigned int> nStakeTipGeneration(0);
+
+void UpdateKernelStakeModifiers()
+{
+    nStakeTipGeneration++;
+
+    LOCK(cs_kernelModifiers);
+
+    // Drop the entries a reorg invalidated from the top, stale ones further down are recomputed on lookup
+    while (!vKernelModifiers.empty() && !IsKernelModifierValid(vKernelModifiers.back(), chainActive[vKernelModifiers.size() - 1]))
+        vKernelModifiers.pop_back();
+
+    // Add the block-froms whose selection interval is complete now, lookups above the cache compute their own
+    const int nFillStop = std::min(chainActive.Height(), (int)vKernelModifiers.size() + MAX_KERNEL_MODIFIER_FILL - 1);
+    if (vKernelModifiers.empty() && chainActive.Height() >= MAX_KERNEL_MODIFIER_FILL)
+        LogPrintf("UpdateKernelStakeModifiers : filling the kernel stake modifier cache for %d blocks, %d per new tip\n", chainActive.Height() + 1, MAX_KERNEL_MODIFIER_FILL);
+    CKernelModifierEntry entry;
+    while ((int)vKernelModifiers.size() <= nFillStop && FindKernelStakeModifier(chainActive[vKernelModifiers.size()], entry))
+        vKernelModifiers.push_back(entry);
+}
+
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom)
 {
     //BitMoney will hash in the transaction hash and the index number in order to make sure each hash is unique
@@ -292,7 +378,7 @@ bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTarget
 }
 
 //instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockHeader& blockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
 {
     //assign new variables to make it easier to read
     int64_t nValueIn = txPrev.vout[prevout.n].nValue;
@@ -309,10 +395,15 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
     bnTargetPerCoinDay.SetCompact(nBits);
 
     //grab stake modifier
+    BlockMap::iterator it = mapBlockIndex.find(blockFrom.GetHash());
+    if (it == mapBlockIndex.end())
+        return error("CheckStakeKernelHash() : block not indexed");
+    const CBlockIndex* pindexFrom = it->second;
+
     uint64_t nStakeModifier = 0;
     int nStakeModifierHeight = 0;
     int64_t nStakeModifierTime = 0;
-    if (!GetKernelStakeModifier(blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake)) {
+    if (!GetKernelStakeModifier(pindexFrom, nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake)) {
         LogPrintf("CheckStakeKernelHash(): failed to get kernel stake modifier \n");
         return false;
     }
@@ -352,7 +443,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
             LogPrintf("CheckStakeKernelHash() : using modifier %s at height=%d timestamp=%s for block from height=%d timestamp=%s\n",
                 boost::lexical_cast<std::string>(nStakeModifier).c_str(), nStakeModifierHeight,
                 DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nStakeModifierTime).c_str(),
-                mapBlockIndex[blockFrom.GetHash()]->nHeight,
+                pindexFrom->nHeight,
                 DateTimeStrFormat("%Y-%m-%d %H:%M:%S", blockFrom.GetBlockTime()).c_str());
             LogPrintf("CheckStakeKernelHash() : pass protocol=%s modifier=%s nTimeBlockFrom=%u prevoutHash=%s nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
                 "0.3",
@@ -368,10 +459,234 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
     return fSuccess;
 }
 
+bool GetStakeKernelCandidate(const CBlockIndex* pindexFrom, const COutPoint& prevout, int64_t nValue, CStakeKernelCandidate& candidate)
+{
+    int nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime = 0;
+    if (!GetKernelStakeModifier(pindexFrom, candidate.nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+        return false;
+
+    candidate.prevout = prevout;
+    candidate.nValue = nValue;
+    candidate.nTimeBlockFrom = pindexFrom->GetBlockTime();
+    candidate.InitHasher();
+    return true;
+}
+
+void CStakeKernelCandidate::InitHasher()
+{
+    // Same layout as the CDataStream serialization in stakeHash(), minus nTimeTx
+    unsigned char prefix[8 + 4 + 4 + 32];
+    WriteLE64(prefix, nStakeModifier);
+    WriteLE32(prefix + 8, nTimeBlockFrom);
+    WriteLE32(prefix + 12, prevout.n);
+    memcpy(prefix + 16, prevout.hash.begin(), 32);
+    hasherPrefix.Reset().Write(prefix, sizeof(prefix));
+}
+
+uint256 stakeHash(const CStakeKernelCandidate& candidate, unsigned int nTimeTx)
+{
+    unsigned char time[4];
+    WriteLE32(time, nTimeTx);
+
+    unsigned char buf[CSHA256::OUTPUT_SIZE];
+    CSHA256 hasher(candidate.hasherPrefix);
+    hasher.Write(time, sizeof(time)).Finalize(buf);
+
+    uint256 result;
+    hasher.Reset().Write(buf, sizeof(buf)).Finalize(result.begin());
+    return result;
+}
+
+/** Shared state of one FindStakeKernel() run */
+struct CStakeKernelSearch {
+    const std::vector<CStakeKernelCandidate>* pvCandidates;
+    uint256 bnTargetPerCoinDay;
+    unsigned int nTimeTx;
+    unsigned int nHashDrift;
+    unsigned int nTimeMin;
+    int nHeightStart;
+    unsigned int nTipGeneration;
+
+    //! Lowest candidate index with a kernel so far, candidates after it need not be hashed
+    std::atomic<size_t> nFound;
+};
+
+/** Kernel found by one worker */
+struct CStakeKernelResult {
+    size_t nFound;
+    unsigned int nTimeTx;
+    uint256 hashProofOfStake;
+};
+
+static void SearchStakeKernels(CStakeKernelSearch* psearch, size_t nStart, size_t nStride, CStakeKernelResult* presult)
+{
+    const std::vector<CStakeKernelCandidate>& vCandidates = *psearch->pvCandidates;
+    presult->nFound = vCandidates.size();
+
+    for (size_t i = nStart; i < vCandidates.size() && i < psearch->nFound; i += nStride) {
+        //new block came in, move on
+        if (nStakeTipGeneration != psearch->nTipGeneration)
+            break;
+
+        const CStakeKernelCandidate& candidate = vCandidates[i];
+        if (psearch->nTimeTx < candidate.nTimeBlockFrom || candidate.nTimeBlockFrom + nStakeMinAge > psearch->nTimeTx)
+            continue;
+
+        // Same target as stakeTargetHit(), computed once per output
+        uint256 bnTarget = uint256(candidate.nValue) / 100 * psearch->bnTargetPerCoinDay;
+        for (unsigned int j = 0; j < psearch->nHashDrift; j++) {
+            unsigned int nTryTime = psearch->nTimeTx + psearch->nHashDrift - j;
+            uint256 hashProofOfStake = stakeHash(candidate, nTryTime);
+            if (!(hashProofOfStake < bnTarget))
+                continue;
+
+            // Later tries only give older timestamps, so this output is done either way
+            if (nTryTime > psearch->nTimeMin) {
+                presult->nFound = i;
+                presult->nTimeTx = nTryTime;
+                presult->hashProofOfStake = hashProofOfStake;
+
+                size_t nFound = psearch->nFound;
+                while (i < nFound && !psearch->nFound.compare_exchange_weak(nFound, i)) {
+                }
+                return;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Worker threads for FindStakeKernel(), started on first use and kept for the
+ * life of the process so a search round does not pay for thread creation.
+ * Worker i searches every nStride-th candidate from i in a round.
+ */
+class CStakeSearchPool
+{
+private:
+    boost::mutex csRun; //! one search at a time
+    boost::mutex cs;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    boost::thread_group threadGroup;
+    size_t nWorkers;
+    unsigned int nRound;
+    size_t nPending;
+    bool fShutdown;
+
+    CStakeKernelSearch* psearch;
+    std::vector<CStakeKernelResult>* pvResults;
+    size_t nStride;
+
+    void Worker(size_t nWorker)
+    {
+        RenameThread("BitMoney-stakesearch");
+        unsigned int nRoundDone = 0;
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            while (!fShutdown && nRound == nRoundDone)
+                condWork.wait(lock);
+            if (fShutdown)
+                return;
+            nRoundDone = nRound;
+            if (nWorker >= nStride)
+                continue;
+
+            lock.unlock();
+            SearchStakeKernels(psearch, nWorker, nStride, &(*pvResults)[nWorker]);
+            lock.lock();
+            if (--nPending == 0)
+                condDone.notify_all();
+        }
+    }
+
+public:
+    CStakeSearchPool() : nWorkers(0), nRound(0), nPending(0), fShutdown(false), psearch(NULL), pvResults(NULL), nStride(0) {}
+
+    ~CStakeSearchPool()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fShutdown = true;
+        }
+        condWork.notify_all();
+        threadGroup.join_all();
+    }
+
+    void Run(CStakeKernelSearch* psearchIn, std::vector<CStakeKernelResult>& vResults)
+    {
+        boost::unique_lock<boost::mutex> lockRun(csRun);
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (nWorkers < vResults.size())
+            threadGroup.create_thread(boost::bind(&CStakeSearchPool::Worker, this, nWorkers++));
+
+        psearch = psearchIn;
+        pvResults = &vResults;
+        nStride = vResults.size();
+        nPending = nStride;
+        nRound++;
+        condWork.notify_all();
+        while (nPending > 0)
+            condDone.wait(lock);
+    }
+};
+
+static CStakeSearchPool stakeSearchPool;
+
+bool FindStakeKernel(const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nBits, unsigned int& nTimeTx, unsigned int nHashDrift, unsigned int nTimeMin, size_t& nFound, uint256& hashProofOfStake)
+{
+    CStakeKernelSearch search;
+    search.pvCandidates = &vCandidates;
+    search.bnTargetPerCoinDay.SetCompact(nBits);
+    search.nTimeTx = nTimeTx;
+    search.nHashDrift = nHashDrift;
+    search.nTimeMin = nTimeMin;
+    search.nFound = vCandidates.size();
+    {
+        LOCK(cs_main);
+        search.nHeightStart = chainActive.Height();
+        search.nTipGeneration = nStakeTipGeneration;
+    }
+
+    // Small sets are not worth handing to the pool
+    size_t nThreads = std::min((size_t)std::max(1, std::min((int)boost::thread::hardware_concurrency(), 16)),
+        vCandidates.size() / STAKE_SEARCH_MIN_PER_THREAD + 1);
+    std::vector<CStakeKernelResult> vResults(nThreads);
+    if (nThreads == 1)
+        SearchStakeKernels(&search, 0, 1, &vResults[0]);
+    else
+        stakeSearchPool.Run(&search, vResults);
+
+    mapHashedBlocks.clear();
+    mapHashedBlocks[search.nHeightStart] = GetTime(); //store a time stamp of when we last hashed on this block
+
+    nFound = vCandidates.size();
+    for (const CStakeKernelResult& result : vResults) {
+        if (result.nFound < nFound) {
+            nFound = result.nFound;
+            nTimeTx = result.nTimeTx;
+            hashProofOfStake = result.hashProofOfStake;
+        }
+    }
+    if (nFound == vCandidates.size())
+        return false;
+
+    if (fDebug || GetBoolArg("-printcoinstake", false)) {
+        const CStakeKernelCandidate& candidate = vCandidates[nFound];
+        LogPrintf("FindStakeKernel() : pass protocol=%s modifier=%s nTimeBlockFrom=%u prevoutHash=%s nPrevout=%u nTimeTx=%u hashProof=%s\n",
+            "0.3",
+            boost::lexical_cast<std::string>(candidate.nStakeModifier).c_str(),
+            candidate.nTimeBlockFrom, candidate.prevout.hash.ToString().c_str(), candidate.prevout.n, nTimeTx,
+            hashProofOfStake.ToString().c_str());
+    }
+    return true;
+}
+
 // Check kernel hash target and coinstake signature
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
+bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake)
 {
-    const CTransaction tx = block.vtx[1];
+    const CTransaction& tx = block.vtx[1];
     if (!tx.IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx.GetHash().ToString().c_str());
 
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_KERNEL_H
 #define BITCOIN_KERNEL_H
 
+#include "crypto/sha256.h"
 #include "main.h"
 
 
@@ -18,18 +19,57 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+// Most block-froms added to the kernel stake modifier cache per new tip, so the
+// first fill after startup is spread over several tips instead of one long cs_main hold
+static const int MAX_KERNEL_MODIFIER_FILL = 10000;
+
+// Minimum number of kernel candidates per stake search thread
+static const size_t STAKE_SEARCH_MIN_PER_THREAD = 64;
+
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// Get the stake modifier a kernel from pindexFrom hashes with, from a cache of the active chain
+bool GetKernelStakeModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake);
+
+// Bring the kernel stake modifier cache in line with a new tip of chainActive
+void UpdateKernelStakeModifiers();
+
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockHeader& blockFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+
+/**
+ * A stakeable output together with the parts of its kernel that do not change
+ * while the tip stays the same. The stake hash is a double SHA256 over
+ * modifier|nTimeBlockFrom|prevout.n|prevout.hash|nTimeTx; everything but the
+ * timestamp is written into hasherPrefix once, so hashing the drift window
+ * only feeds four bytes per try.
+ */
+struct CStakeKernelCandidate {
+    COutPoint prevout;
+    int64_t nValue;
+    unsigned int nTimeBlockFrom;
+    uint64_t nStakeModifier;
+    CSHA256 hasherPrefix;
+
+    //! Write the fields above into hasherPrefix
+    void InitHasher();
+};
+
+// Fill in the kernel candidate for an output of a transaction in pindexFrom
+bool GetStakeKernelCandidate(const CBlockIndex* pindexFrom, const COutPoint& prevout, int64_t nValue, CStakeKernelCandidate& candidate);
+uint256 stakeHash(const CStakeKernelCandidate& candidate, unsigned int nTimeTx);
+
+// Search the drift window above nTimeTx for every candidate, splitting them across a pool of worker threads.
+// Returns the first candidate in vCandidates with a kernel newer than nTimeMin and sets nTimeTx to its time.
+bool FindStakeKernel(const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nBits, unsigned int& nTimeTx, unsigned int nHashDrift, unsigned int nTimeMin, size_t& nFound, uint256& hashProofOfStake);
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake);
+bool CheckProofOfStake(const CBlock& block, uint256& hashProofOfStake);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
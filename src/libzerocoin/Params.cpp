@@ -25,6 +25,17 @@ ZerocoinParams::ZerocoinParams(CBigNum N, uint32_t securityLevel) {
 	// Generate the parameters
 	CalculateParams(*this, N, ZEROCOIN_PROTOCOL_VERSION, securityLevel);
 
+	// Cache Montgomery contexts for the moduli used by accumulators, witnesses and proofs
+	CBigNum::registerModulus(this->accumulatorParams.accumulatorModulus);
+	CBigNum::registerModulus(this->accumulatorParams.accumulatorPoKCommitmentGroup.modulus);
+	CBigNum::registerModulus(this->accumulatorParams.accumulatorQRNCommitmentGroup.modulus);
+	CBigNum::registerModulus(this->coinCommitmentGroup.modulus);
+	CBigNum::registerModulus(this->serialNumberSoKCommitmentGroup.modulus);
+
+	// Build the fixed-base tables used by the serial number signature of knowledge
+	this->coinCommitmentGroup.precompute();
+	this->serialNumberSoKCommitmentGroup.precompute();
+
 	this->accumulatorParams.initialized = true;
 	this->initialized = true;
 }
@@ -44,4 +55,98 @@ CBigNum IntegerGroupParams::randomElement() const {
 	return this->g.pow_mod(CBigNum::randBignum(this->groupOrder),this->modulus);
 }
 
+void IntegerGroupParams::precompute() {
+	this->fixedBase = std::make_shared<const FixedBaseTables>(this->g, this->h, this->modulus, this->groupOrder);
+}
+
+CBigNum IntegerGroupParams::gPow(const CBigNum& a) const {
+	if (!this->fixedBase)
+		return this->g.pow_mod(a, this->modulus);
+	return this->fixedBase->pow(&a, NULL);
+}
+
+CBigNum IntegerGroupParams::hPow(const CBigNum& b) const {
+	if (!this->fixedBase)
+		return this->h.pow_mod(b, this->modulus);
+	return this->fixedBase->pow(NULL, &b);
+}
+
+CBigNum IntegerGroupParams::ghPow(const CBigNum& a, const CBigNum& b) const {
+	if (!this->fixedBase)
+		return this->g.pow_mod(a, this->modulus).mul_mod(this->h.pow_mod(b, this->modulus), this->modulus);
+	return this->fixedBase->pow(&a, &b);
+}
+
+FixedBaseTables::FixedBaseTables(const CBigNum& g, const CBigNum& h, const CBigNum& modulusIn, const CBigNum& groupOrderIn) :
+	modulus(modulusIn), groupOrder(groupOrderIn) {
+	CAutoBN_CTX pctx;
+	this->mont = CBigNum::registerModulus(this->modulus);
+
+	this->nWindows = (this->groupOrder.bitSize() + FIXED_BASE_WINDOW_BITS - 1) / FIXED_BASE_WINDOW_BITS;
+	buildTable(this->gTable, g, pctx);
+	buildTable(this->hTable, h, pctx);
+}
+
+void FixedBaseTables::buildTable(std::vector<CBigNum>& table, const CBigNum& base, BN_CTX* ctx) {
+	const uint32_t nDigits = 1 << FIXED_BASE_WINDOW_BITS;
+	table.resize(this->nWindows * nDigits);
+
+	// cur = base^(2^(w*i)) for the current window i
+	CBigNum cur = base % this->modulus;
+	if (!BN_to_montgomery(&cur, &cur, this->mont, ctx))
+		throw bignum_error("FixedBaseTables : BN_to_montgomery failed");
+
+	for (uint32_t i = 0; i < this->nWindows; i++) {
+		CBigNum* row = &table[i * nDigits];
+		row[1] = cur;
+		for (uint32_t d = 2; d < nDigits; d++) {
+			if (!BN_mod_mul_montgomery(&row[d], &row[d - 1], &cur, this->mont, ctx))
+				throw bignum_error("FixedBaseTables : BN_mod_mul_montgomery failed");
+		}
+		if (!BN_mod_mul_montgomery(&cur, &row[nDigits - 1], &cur, this->mont, ctx))
+			throw bignum_error("FixedBaseTables : BN_mod_mul_montgomery failed");
+	}
+}
+
+void FixedBaseTables::mulTable(CBigNum& r, bool& fEmpty, const std::vector<CBigNum>& table, const CBigNum& e, BN_CTX* ctx) const {
+	const uint32_t nDigits = 1 << FIXED_BASE_WINDOW_BITS;
+
+	// The generators have order groupOrder, so a reduced (and non-negative) exponent gives the same power
+	CBigNum exp = e % this->groupOrder;
+	for (uint32_t i = 0; i < this->nWindows; i++) {
+		uint32_t d = 0;
+		for (uint32_t j = 0; j < FIXED_BASE_WINDOW_BITS; j++) {
+			if (BN_is_bit_set(&exp, i * FIXED_BASE_WINDOW_BITS + j))
+				d |= 1 << j;
+		}
+		if (d == 0)
+			continue;
+
+		const CBigNum& entry = table[i * nDigits + d];
+		if (fEmpty) {
+			r = entry;
+			fEmpty = false;
+		} else if (!BN_mod_mul_montgomery(&r, &r, &entry, this->mont, ctx)) {
+			throw bignum_error("FixedBaseTables::pow : BN_mod_mul_montgomery failed");
+		}
+	}
+}
+
+CBigNum FixedBaseTables::pow(const CBigNum* a, const CBigNum* b) const {
+	CAutoBN_CTX pctx;
+	CBigNum r;
+	bool fEmpty = true;
+	if (a != NULL)
+		mulTable(r, fEmpty, this->gTable, *a, pctx);
+	if (b != NULL)
+		mulTable(r, fEmpty, this->hTable, *b, pctx);
+
+	if (fEmpty)
+		return CBigNum(1);
+
+	if (!BN_from_montgomery(&r, &r, this->mont, pctx))
+		throw bignum_error("FixedBaseTables::pow : BN_from_montgomery failed");
+	return r;
+}
+
 } /* namespace libzerocoin */
@@ -13,11 +13,45 @@
 #ifndef PARAMS_H_
 #define PARAMS_H_
 
+#include <memory>
+#include <vector>
 #include "bignum.h"
 #include "ZerocoinDefines.h"
 
 namespace libzerocoin {
 
+/** Precomputed fixed-base window tables for the two generators of an integer group.
+ *
+ * For a base x the table holds x^(d * 2^(w*i)) mod p in Montgomery form for every
+ * window i and digit d, so x^e is a product of one entry per window of e and needs
+ * no squarings. Products g^a * h^b are accumulated in a single pass over both tables.
+ * Exponents are reduced modulo the group order, which both generators must have.
+ **/
+class FixedBaseTables {
+public:
+	FixedBaseTables(const CBigNum& g, const CBigNum& h, const CBigNum& modulus, const CBigNum& groupOrder);
+
+	/**
+	 * Computes g^a * h^b mod p. Either exponent may be NULL to leave out its base.
+	 * @return the product
+	 */
+	CBigNum pow(const CBigNum* a, const CBigNum* b) const;
+
+private:
+	FixedBaseTables(const FixedBaseTables&);
+	FixedBaseTables& operator=(const FixedBaseTables&);
+
+	void buildTable(std::vector<CBigNum>& table, const CBigNum& base, BN_CTX* ctx);
+	void mulTable(CBigNum& r, bool& fEmpty, const std::vector<CBigNum>& table, const CBigNum& e, BN_CTX* ctx) const;
+
+	CBigNum modulus;
+	CBigNum groupOrder;
+	BN_MONT_CTX* mont;
+	uint32_t nWindows;
+	std::vector<CBigNum> gTable;
+	std::vector<CBigNum> hTable;
+};
+
 class IntegerGroupParams {
 public:
 	/** @brief Integer group class, default constructor
@@ -31,6 +65,28 @@ public:
 	 * @return a random element in the group.
 	 */
 	CBigNum randomElement() const;
+
+	/**
+	 * Builds the fixed-base tables used by gPow, hPow and ghPow.
+	 * The tables are not serialized and are shared between copies.
+	 */
+	void precompute();
+
+	/**
+	 * @return g^a mod modulus
+	 */
+	CBigNum gPow(const CBigNum& a) const;
+
+	/**
+	 * @return h^b mod modulus
+	 */
+	CBigNum hPow(const CBigNum& b) const;
+
+	/**
+	 * @return g^a * h^b mod modulus
+	 */
+	CBigNum ghPow(const CBigNum& a, const CBigNum& b) const;
+
 	bool initialized;
 
 	/**
@@ -55,6 +111,11 @@ public:
 	 */
 	CBigNum groupOrder;
 
+	/**
+	 * Precomputed tables for g and h, NULL until precompute() is called.
+	 */
+	std::shared_ptr<const FixedBaseTables> fixedBase;
+
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
 		    READWRITE(initialized);
@@ -110,23 +110,26 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 inline CBigNum SerialNumberSignatureOfKnowledge::challengeCalculation(const CBigNum& a_exp,const CBigNum& b_exp,
         const CBigNum& h_exp) const {
 
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
-	CBigNum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder)
-	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
+	const IntegerGroupParams& coinGroup = params->coinCommitmentGroup;
+	const IntegerGroupParams& sokGroup = params->serialNumberSoKCommitmentGroup;
+
+	// a^{a_exp} b^{b_exp} lives in the coin commitment group, whose modulus is the SoK group order
+	CBigNum exponent;
+	if (coinGroup.modulus == sokGroup.groupOrder) {
+		exponent = coinGroup.ghPow(a_exp, b_exp);
+	} else {
+		exponent = (coinGroup.g.pow_mod(a_exp, sokGroup.groupOrder)
+		           * coinGroup.h.pow_mod(b_exp, sokGroup.groupOrder)) % sokGroup.groupOrder;
+	}
 
-	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+	return sokGroup.ghPow(exponent, h_exp);
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
         const uint256 msghash) const {
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
+	const IntegerGroupParams& coinGroup = params->coinCommitmentGroup;
+	const IntegerGroupParams& sokGroup = params->serialNumberSoKCommitmentGroup;
+	bool fFixedBase = (coinGroup.modulus == sokGroup.groupOrder);
 	CHashWriter hasher(0,0);
 	hasher << *params << valueOfCommitmentToCoin << coinSerialNumber << msghash;
 
@@ -140,10 +143,8 @@ bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, c
 		if(challenge_bit) {
 			tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], SeedTo1024(sprime[i].getuint256()));
 		} else {
-			CBigNum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-			tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-			             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
-			            params->serialNumberSoKCommitmentGroup.modulus;
+			CBigNum exp = fFixedBase ? coinGroup.hPow(s_notprime[i]) : coinGroup.h.pow_mod(s_notprime[i], sokGroup.groupOrder);
+			tprime[i] = valueOfCommitmentToCoin.pow_mod(exp, sokGroup.modulus).mul_mod(sokGroup.hPow(sprime[i]), sokGroup.modulus);
 		}
 	}
 	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
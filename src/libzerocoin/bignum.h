@@ -6,7 +6,10 @@
 #ifndef BITCOIN_BIGNUM_H
 #define BITCOIN_BIGNUM_H
 
+#include <atomic>
+#include <mutex>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 #include <openssl/bn.h>
 #include "serialize.h"
@@ -21,7 +24,126 @@ public:
 };
 
 
-/** RAII encapsulated BN_CTX (OpenSSL bignum context) */
+/** Per-thread free list of BN_CTX objects, so modular arithmetic does not allocate a context per call */
+class CBN_CTXPool
+{
+private:
+    std::vector<BN_CTX*> vFree;
+
+public:
+    ~CBN_CTXPool()
+    {
+        for (BN_CTX* pctx : vFree)
+            BN_CTX_free(pctx);
+    }
+
+    BN_CTX* Get()
+    {
+        if (vFree.empty())
+            return BN_CTX_new();
+        BN_CTX* pctx = vFree.back();
+        vFree.pop_back();
+        return pctx;
+    }
+
+    void Release(BN_CTX* pctx)
+    {
+        if (pctx != NULL)
+            vFree.push_back(pctx);
+    }
+
+    static CBN_CTXPool& Local()
+    {
+        static thread_local CBN_CTXPool pool;
+        return pool;
+    }
+};
+
+
+/**
+ * Montgomery contexts for moduli that stay fixed for the lifetime of the process
+ * (accumulator modulus, commitment group moduli). Modular exponentiations by a
+ * registered modulus reuse the context instead of setting up a new one per call.
+ *
+ * Entries are only ever appended and are published through nEntries, so Find()
+ * reads the registry without a lock; only Register() serializes on cs.
+ */
+class CMontCtxRegistry
+{
+private:
+    static const size_t MAX_ENTRIES = 16;
+
+    std::mutex cs;
+    BIGNUM* vModuli[MAX_ENTRIES];
+    BN_MONT_CTX* vContexts[MAX_ENTRIES];
+    std::atomic<size_t> nEntries;
+
+    CMontCtxRegistry() : nEntries(0) {}
+
+    BN_MONT_CTX* FindIn(const BIGNUM* m, size_t nCount) const
+    {
+        for (size_t i = 0; i < nCount; i++) {
+            if (BN_cmp(vModuli[i], m) == 0)
+                return vContexts[i];
+        }
+        return NULL;
+    }
+
+public:
+    ~CMontCtxRegistry()
+    {
+        for (size_t i = 0; i < nEntries; i++) {
+            BN_MONT_CTX_free(vContexts[i]);
+            BN_free(vModuli[i]);
+        }
+    }
+
+    static CMontCtxRegistry& Instance()
+    {
+        static CMontCtxRegistry registry;
+        return registry;
+    }
+
+    /** Return the context for modulus m, or NULL if m was never registered */
+    BN_MONT_CTX* Find(const BIGNUM* m) const
+    {
+        return FindIn(m, nEntries.load(std::memory_order_acquire));
+    }
+
+    /** Register an odd modulus m and return its context (existing contexts are reused) */
+    BN_MONT_CTX* Register(const BIGNUM* m)
+    {
+        if (!BN_is_odd(m))
+            throw bignum_error("CMontCtxRegistry::Register : modulus must be odd");
+
+        std::lock_guard<std::mutex> lock(cs);
+        const size_t nCount = nEntries.load(std::memory_order_relaxed);
+        BN_MONT_CTX* existing = FindIn(m, nCount);
+        if (existing != NULL)
+            return existing;
+        if (nCount == MAX_ENTRIES)
+            throw bignum_error("CMontCtxRegistry::Register : too many moduli");
+
+        BN_CTX* pctx = CBN_CTXPool::Local().Get();
+        BN_MONT_CTX* mont = BN_MONT_CTX_new();
+        BIGNUM* mcopy = BN_dup(m);
+        bool fOk = pctx != NULL && mont != NULL && mcopy != NULL && BN_MONT_CTX_set(mont, m, pctx);
+        CBN_CTXPool::Local().Release(pctx);
+        if (!fOk) {
+            BN_MONT_CTX_free(mont);
+            BN_free(mcopy);
+            throw bignum_error("CMontCtxRegistry::Register : BN_MONT_CTX_set failed");
+        }
+
+        vModuli[nCount] = mcopy;
+        vContexts[nCount] = mont;
+        nEntries.store(nCount + 1, std::memory_order_release);
+        return mont;
+    }
+};
+
+
+/** RAII encapsulated BN_CTX (OpenSSL bignum context), borrowed from the thread's CBN_CTXPool */
 class CAutoBN_CTX
 {
 protected:
@@ -31,15 +153,14 @@ protected:
 public:
     CAutoBN_CTX()
     {
-        pctx = BN_CTX_new();
+        pctx = CBN_CTXPool::Local().Get();
         if (pctx == NULL)
             throw bignum_error("CAutoBN_CTX : BN_CTX_new() returned NULL");
     }
 
     ~CAutoBN_CTX()
     {
-        if (pctx != NULL)
-            BN_CTX_free(pctx);
+        CBN_CTXPool::Local().Release(pctx);
     }
 
     operator BN_CTX*() { return pctx; }
@@ -530,19 +651,30 @@ public:
     CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const {
         CAutoBN_CTX pctx;
         CBigNum ret;
+        BN_MONT_CTX* mont = CMontCtxRegistry::Instance().Find(&m);
         if( e < 0){
             // g^-x = (g^-1)^x
             CBigNum inv = this->inverse(m);
             CBigNum posE = e * -1;
-            if (!BN_mod_exp(&ret, &inv, &posE, &m, pctx))
+            if (!(mont ? BN_mod_exp_mont(&ret, &inv, &posE, &m, pctx, mont) : BN_mod_exp(&ret, &inv, &posE, &m, pctx)))
                 throw bignum_error("CBigNum::pow_mod: BN_mod_exp failed on negative exponent");
         }else
-            if (!BN_mod_exp(&ret, this, &e, &m, pctx))
+            if (!(mont ? BN_mod_exp_mont(&ret, this, &e, &m, pctx, mont) : BN_mod_exp(&ret, this, &e, &m, pctx)))
                 throw bignum_error("CBigNum::pow_mod : BN_mod_exp failed");
 
         return ret;
     }
 
+    /**
+     * Registers m as a modulus that stays fixed for the lifetime of the process,
+     * so that pow_mod by m reuses a cached Montgomery context.
+     * @param m an odd modulus
+     * @return the Montgomery context of m
+     */
+    static BN_MONT_CTX* registerModulus(const CBigNum& m) {
+        return CMontCtxRegistry::Instance().Register(&m);
+    }
+
    /**
     * Calculates the inverse of this element mod m.
     * i.e. i such this*i = 1 mod m
@@ -78,7 +78,7 @@ bool fTxIndex = true;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
-unsigned int nCoinCacheSize = 5000;
+size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
 
 unsigned int nStakeMinAge = 1 * 60 * 60;
@@ -1069,6 +1069,25 @@ void FindMints(vector<CZerocoinMint> vMintsToFind, vector<CZerocoinMint>& vMints
             if(chainActive[i]->vMintDenominationsInBlock.empty())
                 continue;
 
+            // only load the full block when the pubcoin index says it holds one of the missing mints
+            std::list<PublicCoin> listPubcoins;
+            if(!BlockIndexToPubcoinList(chainActive[i], listPubcoins))
+                continue;
+
+            bool fFound = false;
+            for (const PublicCoin& pubcoin : listPubcoins) {
+                for (const CZerocoinMint& mintMissing : vMissingMints) {
+                    if (mintMissing.GetValue() == pubcoin.getValue()) {
+                        fFound = true;
+                        break;
+                    }
+                }
+                if (fFound)
+                    break;
+            }
+            if (!fFound)
+                continue;
+
             CBlock block;
             if(!ReadBlockFromDisk(block, chainActive[i]))
                 continue;
@@ -1229,6 +1248,78 @@ bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMin
     return true;
 }
 
+//return the pubcoins minted in a block, optionally of a single denomination. Indexed blocks are served from
+//the zerocoin database, anything else falls back to reading the full block from disk
+bool BlockIndexToPubcoinList(const CBlockIndex* pindex, std::list<PublicCoin>& listPubcoins, CoinDenomination denom)
+{
+    std::list<PublicCoin> listIndexed;
+    bool fIndexed = true;
+    for (auto denomIndexed : zerocoinDenomList) {
+        if (denom != ZQ_ERROR && denomIndexed != denom)
+            continue;
+
+        std::vector<CBigNum> vValues;
+        if (!zerocoinDB->ReadBlockPubcoins(pindex, denomIndexed, vValues)) {
+            fIndexed = false;
+            break;
+        }
+
+        for (const CBigNum& bnValue : vValues)
+            listIndexed.emplace_back(PublicCoin(Params().Zerocoin_Params(), bnValue, denomIndexed));
+    }
+
+    if (fIndexed) {
+        listPubcoins.splice(listPubcoins.end(), listIndexed);
+        return true;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : failed to read block %d from disk", __func__, pindex->nHeight);
+
+    std::list<PublicCoin> listBlock;
+    if (!BlockToPubcoinList(block, listBlock))
+        return false;
+
+    for (const PublicCoin& pubcoin : listBlock) {
+        if (denom == ZQ_ERROR || pubcoin.getDenomination() == denom)
+            listPubcoins.emplace_back(pubcoin);
+    }
+
+    return true;
+}
+
+//backfill the pubcoin index of the zerocoin database for blocks that were connected before it existed
+bool ReindexZerocoinPubcoins()
+{
+    LOCK(cs_main);
+    int nHeightStart = Params().Zerocoin_AccumulatorStartHeight();
+    if (chainActive.Height() < nHeightStart)
+        return true;
+
+    LogPrintf("%s : indexing pubcoins from block %d to %d\n", __func__, nHeightStart, chainActive.Height());
+    for (CBlockIndex* pindex = chainActive[nHeightStart]; pindex; pindex = chainActive.Next(pindex)) {
+        if (ShutdownRequested())
+            return false;
+
+        if (pindex->nHeight % 1000 == 0)
+            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex))
+            return error("%s : failed to read block %d from disk", __func__, pindex->nHeight);
+
+        std::list<CZerocoinMint> listMints;
+        if (!BlockToZerocoinMintList(block, listMints))
+            return error("%s : failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+        if (!zerocoinDB->WriteBlockPubcoins(pindex, listMints))
+            return error("%s : failed to write pubcoins of block %d", __func__, pindex->nHeight);
+    }
+
+    return true;
+}
+
 bool BlockToMintValueVector(const CBlock& block, const CoinDenomination denom, vector<CBigNum>& vValues)
 {
     for (const CTransaction tx : block.vtx) {
@@ -1298,6 +1389,81 @@ CoinSpend TxInToZerocoinSpend(const CTxIn& txin)
     return CoinSpend(Params().Zerocoin_Params(), serializedCoinSpend);
 }
 
+namespace
+{
+/**
+ * Valid zerocoin spends are parsed when they enter the mempool, again by the miner and
+ * twice more when the block containing them is checked and connected. Keep the parsed
+ * CoinSpend of recently seen inputs, keyed by (txid, input index), together with the
+ * accumulator value its proof was last verified against so that ConnectBlock does not
+ * redo the proof work already done at mempool admission.
+ */
+class CZerocoinSpendCache
+{
+private:
+    typedef std::pair<uint256, unsigned int> Key;
+
+    struct CEntry {
+        boost::shared_ptr<const CoinSpend> pspend;
+        CBigNum bnVerifiedAccumulator; //! 0 until the proof has been verified
+    };
+
+    std::map<Key, CEntry> mapSpends;
+    std::deque<Key> queueInserted; //! insertion order, oldest entries are evicted first
+    CCriticalSection cs_spends;
+
+public:
+    boost::shared_ptr<const CoinSpend> Get(const CTransaction& tx, unsigned int nIn)
+    {
+        const Key key(tx.GetHash(), nIn);
+        {
+            LOCK(cs_spends);
+            std::map<Key, CEntry>::const_iterator it = mapSpends.find(key);
+            if (it != mapSpends.end())
+                return it->second.pspend;
+        }
+
+        // Parse without holding the lock, another thread may race us to the insert
+        boost::shared_ptr<const CoinSpend> pspend(new CoinSpend(TxInToZerocoinSpend(tx.vin[nIn])));
+
+        LOCK(cs_spends);
+        std::pair<std::map<Key, CEntry>::iterator, bool> ret = mapSpends.insert(std::make_pair(key, CEntry()));
+        if (!ret.second)
+            return ret.first->second.pspend;
+        ret.first->second.pspend = pspend;
+        queueInserted.push_back(key);
+        while (queueInserted.size() > MAX_ZEROCOIN_SPEND_CACHE) {
+            mapSpends.erase(queueInserted.front());
+            queueInserted.pop_front();
+        }
+        return pspend;
+    }
+
+    bool IsVerified(const uint256& hashTx, unsigned int nIn, const CBigNum& bnAccumulatorValue)
+    {
+        LOCK(cs_spends);
+        std::map<Key, CEntry>::const_iterator it = mapSpends.find(Key(hashTx, nIn));
+        return it != mapSpends.end() && it->second.bnVerifiedAccumulator != 0 &&
+               it->second.bnVerifiedAccumulator == bnAccumulatorValue;
+    }
+
+    void SetVerified(const uint256& hashTx, unsigned int nIn, const CBigNum& bnAccumulatorValue)
+    {
+        LOCK(cs_spends);
+        std::map<Key, CEntry>::iterator it = mapSpends.find(Key(hashTx, nIn));
+        if (it != mapSpends.end())
+            it->second.bnVerifiedAccumulator = bnAccumulatorValue;
+    }
+};
+
+CZerocoinSpendCache zerocoinSpendCache;
+} // anon namespace
+
+boost::shared_ptr<const CoinSpend> GetZerocoinSpend(const CTransaction& tx, unsigned int nIn)
+{
+    return zerocoinSpendCache.Get(tx, nIn);
+}
+
 bool IsZerocoinSpendUnknown(CoinSpend coinSpend, uint256 hashTx, CValidationState& state)
 {
     uint256 hashTxFromDB;
@@ -1310,7 +1476,19 @@ bool IsZerocoinSpendUnknown(CoinSpend coinSpend, uint256 hashTx, CValidationStat
     return true;
 }
 
-bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state)
+bool CZerocoinSpendCheck::operator()()
+{
+    Accumulator accumulator(Params().Zerocoin_Params(), pspend->getDenomination(), bnAccumulatorValue);
+
+    //Check that the coin is on the accumulator
+    if (!pspend->Verify(accumulator))
+        return ::error("CZerocoinSpendCheck(): zerocoin spend in tx %s did not verify", hashTx.GetHex());
+
+    zerocoinSpendCache.SetVerified(hashTx, nIn, bnAccumulatorValue);
+    return true;
+}
+
+bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -1333,16 +1511,17 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
 
     bool fValidated = false;
     set<CBigNum> serials;
-    list<CoinSpend> vSpends;
     CAmount nTotalRedeemed = 0;
-    for (const CTxIn& txin : tx.vin) {
+    const uint256 hashTx = tx.GetHash();
+    for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+        const CTxIn& txin = tx.vin[nIn];
 
         //only check txin that is a zcspend
         if (!txin.scriptSig.IsZerocoinSpend())
             continue;
 
-        CoinSpend newSpend = TxInToZerocoinSpend(txin);
-        vSpends.push_back(newSpend);
+        boost::shared_ptr<const CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+        const CoinSpend& newSpend = *pspend;
 
         //check that the denomination is valid
         if (newSpend.getDenomination() == ZQ_ERROR)
@@ -1363,11 +1542,19 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
             if(!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue))
                 return state.DoS(100, error("Zerocoinspend could not find accumulator associated with checksum"));
 
-            Accumulator accumulator(Params().Zerocoin_Params(), newSpend.getDenomination(), bnAccumulatorValue);
+            if (zerocoinSpendCache.IsVerified(hashTx, nIn, bnAccumulatorValue)) {
+                // The proof was already checked against this accumulator, e.g. at mempool admission
+            } else if (pvChecks) {
+                // Proof verification is deferred to the zerocoin spend check queue
+                pvChecks->push_back(CZerocoinSpendCheck(pspend, bnAccumulatorValue, hashTx, nIn));
+            } else {
+                Accumulator accumulator(Params().Zerocoin_Params(), newSpend.getDenomination(), bnAccumulatorValue);
 
-            //Check that the coin is on the accumulator
-            if(!newSpend.Verify(accumulator))
-                return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+                //Check that the coin is on the accumulator
+                if(!newSpend.Verify(accumulator))
+                    return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+                zerocoinSpendCache.SetVerified(hashTx, nIn, bnAccumulatorValue);
+            }
         }
 
         if (serials.count(newSpend.getCoinSerialNumber()))
@@ -1384,23 +1571,10 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
         return state.DoS(100, error("Transaction spend more than was redeemed in zerocoins"));
     }
 
-    // Send signal to wallet if this is ours
-    if (pwalletMain) {
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        list <CBigNum> listMySerials = walletdb.ListMintedCoinsSerial();
-        for (const auto& newSpend : vSpends) {
-            list<CBigNum>::iterator it = find(listMySerials.begin(), listMySerials.end(), newSpend.getCoinSerialNumber());
-            if (it != listMySerials.end()) {
-                LogPrintf("%s: %s detected spent zerocoin mint in transaction %s \n", __func__, it->GetHex(), tx.GetHash().GetHex());
-                pwalletMain->NotifyZerocoinChanged(pwalletMain, it->GetHex(), "Used", CT_UPDATED);
-            }
-        }
-    }
-
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvZerocoinChecks)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1458,7 +1632,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, pvZerocoinChecks))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1628,10 +1802,11 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                                      REJECT_DUPLICATE, "bad-txns-inputs-spent");
 
             //Check for double spending of serial #'s
-            for (const CTxIn& txIn : tx.vin) {
-                if (!txIn.scriptSig.IsZerocoinSpend())
+            for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+                if (!tx.vin[nIn].scriptSig.IsZerocoinSpend())
                     continue;
-                CoinSpend spend = TxInToZerocoinSpend(txIn);
+                boost::shared_ptr<const CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+                const CoinSpend& spend = *pspend;
                 int nHeightTx = 0;
                 if (IsSerialInBlockchain(spend.getCoinSerialNumber(), nHeightTx))
                     return state.Invalid(error("%s : zBIT spend with serial %s is already in block %d\n",
@@ -1973,6 +2148,26 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     return true;
 }
 
+/** Read transaction hash stored at postx, as found in the transaction index. Needs no lock. */
+static bool ReadTransactionAtPos(const CDiskTxPos& postx, const uint256& hash, CTransaction& txOut, uint256& hashBlock)
+{
+    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        return error("%s: OpenBlockFile failed", __func__);
+    CBlockHeader header;
+    try {
+        file >> header;
+        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+        file >> txOut;
+    } catch (std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    hashBlock = header.GetHash();
+    if (txOut.GetHash() != hash)
+        return error("%s : txid mismatch", __func__);
+    return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
@@ -1987,23 +2182,8 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
 
         if (fTxIndex) {
             CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (std::exception& e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut.GetHash() != hash)
-                    return error("%s : txid mismatch", __func__);
-                return true;
-            }
+            if (pblocktree->ReadTxIndex(hash, postx))
+                return ReadTransactionAtPos(postx, hash, txOut, hashBlock);
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
@@ -2477,10 +2657,10 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         if (tx.ContainsZerocoins()) {
             if (tx.IsZerocoinSpend()) {
                 //erase all zerocoinspends in this transaction
-                for (const CTxIn txin : tx.vin) {
-                    if (txin.scriptSig.IsZerocoinSpend()) {
-                        CoinSpend spend = TxInToZerocoinSpend(txin);
-                        if (!zerocoinDB->EraseCoinSpend(spend.getCoinSerialNumber()))
+                for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+                    if (tx.vin[nIn].scriptSig.IsZerocoinSpend()) {
+                        boost::shared_ptr<const CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+                        if (!zerocoinDB->EraseCoinSpend(pspend->getCoinSerialNumber()))
                             return error("failed to erase spent zerocoin in block");
                     }
                 }
@@ -2565,6 +2745,9 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
             if(!EraseAccumulatorValues(nCheckpoint, pindex->pprev->nAccumulatorCheckpoint))
                 return error("DisconnectBlock(): failed to erase checkpoint");
         }
+
+        if (pindex->nHeight >= Params().Zerocoin_AccumulatorStartHeight() && !zerocoinDB->EraseBlockPubcoins(pindex))
+            return error("DisconnectBlock(): failed to erase pubcoin index");
     }
 
     if (pfClean) {
@@ -2608,129 +2791,219 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
-void RecalculateZBitMoneyMinted()
-{
-    CBlockIndex *pindex = chainActive[Params().Zerocoin_AccumulatorStartHeight()];
-    int nHeightEnd = chainActive.Height();
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+/**
+ * Zerocoin spend proofs are verified in CheckBlock(), which unlike ConnectBlock() may run
+ * on several threads at once, so the master role of the queue is serialized by a lock.
+ */
+static CCheckQueue<CZerocoinSpendCheck> zerocoinspendcheckqueue(1);
+static CCriticalSection cs_zerocoinspendcheck;
 
-        //overwrite possibly wrong vMintsInBlock data
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+void ThreadZerocoinSpendCheck()
+{
+    RenameThread("BitMoney-zspendch");
+    zerocoinspendcheckqueue.Thread();
+}
 
-        std::list<CZerocoinMint> listMints;
-        BlockToZerocoinMintList(block, listMints);
+/** Supply changes of one block, decoded by a RecalculateMoneySupply() worker */
+struct CBlockSupplyDelta {
+    bool fDecoded;
+    bool fOk;
+    std::vector<CoinDenomination> vMints;
+    std::list<CoinDenomination> listSpends;
+    CAmount nValueIn;
+    CAmount nValueOut;
 
-        vector<libzerocoin::CoinDenomination> vDenomsBefore = pindex->vMintDenominationsInBlock;
-        pindex->vMintDenominationsInBlock.clear();
-        for (auto mint : listMints)
-            pindex->vMintDenominationsInBlock.emplace_back(mint.GetDenomination());
+    CBlockSupplyDelta() : fDecoded(false), fOk(false), nValueIn(0), nValueOut(0) {}
+};
 
-        //Record mints to disk
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+/**
+ * Read pindex from disk and sum what it adds to and removes from the money supply. With
+ * fTxIndexReads the spent outputs are read straight from the transaction index, which takes
+ * no lock, so workers can run while the caller holds cs_main.
+ */
+static bool DecodeBlockSupply(const CBlockIndex* pindex, bool fTxIndexReads, CBlockSupplyDelta& delta)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : failed to read block %d from disk", __func__, pindex->nHeight);
 
-        if (pindex->nHeight < nHeightEnd)
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+    if (pindex->nHeight >= Params().Zerocoin_AccumulatorStartHeight()) {
+        // overwrite possibly wrong vMintsInBlock data
+        std::list<PublicCoin> listPubcoins;
+        if (!BlockIndexToPubcoinList(pindex, listPubcoins))
+            return error("%s : failed to get pubcoins of block %d", __func__, pindex->nHeight);
+        for (const PublicCoin& pubcoin : listPubcoins)
+            delta.vMints.push_back(pubcoin.getDenomination());
+        delta.listSpends = ZerocoinSpendListFromBlock(block);
     }
 
-    pblocktree->Flush();
-}
+    for (const CTransaction& tx : block.vtx) {
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                if (txin.scriptSig.IsZerocoinSpend()) {
+                    delta.nValueIn += txin.nSequence * COIN;
+                    continue;
+                }
 
-void RecalculateZBitMoneySpent()
-{
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_AccumulatorStartHeight()];
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+                CTransaction txPrev;
+                uint256 hashBlock;
+                CDiskTxPos postx;
+                bool fFound = fTxIndexReads ? pblocktree->ReadTxIndex(txin.prevout.hash, postx) && ReadTransactionAtPos(postx, txin.prevout.hash, txPrev, hashBlock)
+                                            : GetTransaction(txin.prevout.hash, txPrev, hashBlock, true);
+                if (!fFound)
+                    return error("%s : input %s of block %d not found", __func__, txin.prevout.ToString(), pindex->nHeight);
+                delta.nValueIn += txPrev.vout[txin.prevout.n].nValue;
+            }
+        }
 
-        //Rewrite zBIT supply
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (i == 0 && tx.IsCoinStake())
+                continue;
 
-        list<libzerocoin::CoinDenomination> listDenomsSpent = ZerocoinSpendListFromBlock(block);
+            delta.nValueOut += tx.vout[i].nValue;
+        }
+    }
 
-        //Reset the supply to previous block
-        pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+    return true;
+}
 
-        //Add mints to zBIT supply
-        for (auto denom : libzerocoin::zerocoinDenomList) {
-            long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-            pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
-        }
+/** Shared state of the RecalculateMoneySupply() decoders and reducer */
+struct CMoneySupplyPipeline {
+    std::vector<CBlockIndex*> vBlocks;
+    std::vector<CBlockSupplyDelta> vSlots; //! ring of decoded blocks, block n goes to slot n % size
+    size_t nNext;                          //! next block to hand to a decoder
+    size_t nReduced;                       //! blocks consumed by the reducer
+    bool fAbort;
+    boost::mutex mutex;
+    boost::condition_variable condDecoded;
+    boost::condition_variable condReduced;
 
-        //Remove spends from zBIT supply
-        for (auto denom : listDenomsSpent)
-            pindex->mapZerocoinSupply.at(denom)--;
+    CMoneySupplyPipeline() : nNext(0), nReduced(0), fAbort(false) {}
+};
 
-        //Rewrite money supply
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+static void ThreadDecodeBlockSupply(CMoneySupplyPipeline* ppipeline)
+{
+    CMoneySupplyPipeline& pipeline = *ppipeline;
+    while (true) {
+        size_t n;
+        {
+            boost::unique_lock<boost::mutex> lock(pipeline.mutex);
+            while (!pipeline.fAbort && pipeline.nNext < pipeline.vBlocks.size() && pipeline.nNext >= pipeline.nReduced + pipeline.vSlots.size())
+                pipeline.condReduced.wait(lock);
+            if (pipeline.fAbort || pipeline.nNext >= pipeline.vBlocks.size())
+                return;
+            n = pipeline.nNext++;
+        }
 
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+        CBlockSupplyDelta delta;
+        delta.fOk = DecodeBlockSupply(pipeline.vBlocks[n], true, delta);
+        delta.fDecoded = true;
+        {
+            boost::unique_lock<boost::mutex> lock(pipeline.mutex);
+            std::swap(pipeline.vSlots[n % pipeline.vSlots.size()], delta);
+        }
+        pipeline.condDecoded.notify_all();
     }
-    pblocktree->Flush();
 }
 
-bool RecalculateBitMoneySupply(int nHeightStart)
+bool RecalculateMoneySupply(int nHeightStart)
 {
-    if (nHeightStart > chainActive.Height())
+    if (nHeightStart < 1)
         return false;
+    if (nHeightStart > chainActive.Height())
+        return true;
 
-    CBlockIndex* pindex = chainActive[nHeightStart];
-    CAmount nSupplyPrev = pindex->pprev->nMoneySupply;
-
-    while (true) {
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+    CMoneySupplyPipeline pipeline;
+    for (CBlockIndex* pindex = chainActive[nHeightStart]; pindex; pindex = chainActive.Next(pindex))
+        pipeline.vBlocks.push_back(pindex);
 
-        CBlock block;
-        assert(ReadBlockFromDisk(block, pindex));
+    // Blocks are read and decoded in parallel and applied in chain order by this thread, as
+    // every block's supply builds on its predecessor's. Without -txindex spent outputs are
+    // looked up under cs_main, so decoding stays on this thread.
+    int nThreads = fTxIndex ? std::max(1, std::min((int)boost::thread::hardware_concurrency(), 16)) : 0;
+    pipeline.vSlots.resize(nThreads > 0 ? MONEY_SUPPLY_DECODE_AHEAD : 1);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&ThreadDecodeBlockSupply, &pipeline));
 
-        CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        for (const CTransaction tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
+    LogPrintf("%s : recalculating blocks %d to %d using %d decoder threads\n", __func__, nHeightStart, chainActive.Height(), nThreads);
+    uiInterface.ShowProgress(_("Recalculating money supply..."), 0);
 
-                if (tx.vin[i].scriptSig.IsZerocoinSpend()) {
-                    nValueIn += tx.vin[i].nSequence * COIN;
-                    continue;
-                }
+    bool fOk = true;
+    CAmount nSupplyPrev = pipeline.vBlocks[0]->pprev->nMoneySupply;
+    std::vector<const CBlockIndex*> vBatch;
+    for (size_t n = 0; n < pipeline.vBlocks.size(); n++) {
+        if (ShutdownRequested()) {
+            fOk = false;
+            break;
+        }
 
-                COutPoint prevout = tx.vin[i].prevout;
-                CTransaction txPrev;
-                uint256 hashBlock;
-                assert(GetTransaction(prevout.hash, txPrev, hashBlock, true));
-                nValueIn += txPrev.vout[prevout.n].nValue;
+        CBlockIndex* pindex = pipeline.vBlocks[n];
+        CBlockSupplyDelta delta;
+        if (nThreads == 0) {
+            delta.fOk = DecodeBlockSupply(pindex, false, delta);
+        } else {
+            {
+                boost::unique_lock<boost::mutex> lock(pipeline.mutex);
+                CBlockSupplyDelta& slot = pipeline.vSlots[n % pipeline.vSlots.size()];
+                while (!slot.fDecoded)
+                    pipeline.condDecoded.wait(lock);
+                std::swap(slot, delta);
+                pipeline.nReduced = n + 1;
             }
+            pipeline.condReduced.notify_all();
+        }
+        if (!delta.fOk) {
+            fOk = false;
+            break;
+        }
 
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                if (i == 0 && tx.IsCoinStake())
-                    continue;
+        if (pindex->nHeight >= Params().Zerocoin_AccumulatorStartHeight()) {
+            pindex->vMintDenominationsInBlock = delta.vMints;
 
-                nValueOut += tx.vout[i].nValue;
+            // Reset the zBIT supply to previous block, add mints and remove spends
+            pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+            for (auto denom : libzerocoin::zerocoinDenomList) {
+                long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
+                pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
             }
+            for (auto denom : delta.listSpends)
+                pindex->mapZerocoinSupply.at(denom)--;
         }
 
-        // Rewrite money supply
-        pindex->nMoneySupply = nSupplyPrev + nValueOut - nValueIn;
+        pindex->nMoneySupply = nSupplyPrev + delta.nValueOut - delta.nValueIn;
         nSupplyPrev = pindex->nMoneySupply;
-        assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
+        vBatch.push_back(pindex);
 
-        if (pindex->nHeight < chainActive.Height())
-            pindex = chainActive.Next(pindex);
-        else
-            break;
+        if (vBatch.size() >= MONEY_SUPPLY_BATCH_SIZE) {
+            // The progress marker goes into the same batch, an interrupted run resumes after it
+            if (!pblocktree->WriteMoneySupplyProgress(vBatch, pindex->nHeight)) {
+                fOk = error("%s : failed to write block index", __func__);
+                break;
+            }
+            vBatch.clear();
+            LogPrintf("%s : block %d...\n", __func__, pindex->nHeight);
+            uiInterface.ShowProgress(_("Recalculating money supply..."), (int)(n * 100 / pipeline.vBlocks.size()));
+        }
     }
+
+    {
+        boost::unique_lock<boost::mutex> lock(pipeline.mutex);
+        pipeline.fAbort = true;
+    }
+    pipeline.condReduced.notify_all();
+    threadGroup.join_all();
+
+    // Commit what was applied; the marker is cleared once the tip is reached
+    int nHeightDone = vBatch.empty() ? 0 : vBatch.back()->nHeight;
+    if (fOk && nHeightDone == chainActive.Height())
+        nHeightDone = 0;
+    if ((!vBatch.empty() || fOk) && !pblocktree->WriteMoneySupplyProgress(vBatch, nHeightDone))
+        fOk = error("%s : failed to write block index", __func__);
     pblocktree->Flush();
-    return true;
+    uiInterface.ShowProgress("", 100);
+
+    return fOk;
 }
 
 static int64_t nTimeVerify = 0;
@@ -2843,10 +3116,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             }
 
             //Check for double spending of serial #'s
-            for (const CTxIn& txIn : tx.vin) {
-                if (!txIn.scriptSig.IsZerocoinSpend())
+            for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+                if (!tx.vin[nIn].scriptSig.IsZerocoinSpend())
                     continue;
-                CoinSpend spend = TxInToZerocoinSpend(txIn);
+                boost::shared_ptr<const CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+                const CoinSpend& spend = *pspend;
                 nValueIn += spend.getDenomination() * COIN;
 
                 // Make sure that the serial number is in valid range
@@ -2914,9 +3188,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     std::list<libzerocoin::CoinDenomination> listSpends = ZerocoinSpendListFromBlock(block);
 
     if (!fVerifyingBlocks && pindex->nHeight == Params().Zerocoin_StartHeight() + 1) {
-        RecalculateZBitMoneyMinted();
-        RecalculateZBitMoneySpent();
-        RecalculateBitMoneySupply(1);
+        if (!RecalculateMoneySupply(1)) {
+            // An interrupted run is picked up again on the next start, see AppInit2
+            if (ShutdownRequested())
+                return error("ConnectBlock() : money supply recalculation interrupted by shutdown");
+            return state.Abort("Failed to recalculate money supply");
+        }
     }
 
     // Initialize zerocoin supply to the supply from previous block
@@ -3025,6 +3302,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    // index the pubcoins of this block so that accumulator code does not have to read it back from disk
+    if (pindex->nHeight >= Params().Zerocoin_AccumulatorStartHeight())
+        if (!zerocoinDB->WriteBlockPubcoins(pindex, listMints))
+            return state.Abort("Failed to write zerocoin pubcoin index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3061,7 +3343,7 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
     static int64_t nLastWrite = 0;
     try {
         if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->DynamicMemoryUsage() > nCoinCacheUsage) ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
             // Typical CCoins structures on disk are around 100 bytes in size.
             // Pushing a new one to the database can cause it to be written
@@ -3116,6 +3398,7 @@ void FlushStateToDisk()
 void static UpdateTip(CBlockIndex* pindexNew)
 {
     chainActive.SetTip(pindexNew);
+    UpdateKernelStakeModifiers();
 
     // If turned on AutoZeromint will automatically convert BitMoney to zBIT
     if (pwalletMain->isZeromintEnabled ())
@@ -3125,10 +3408,10 @@ void static UpdateTip(CBlockIndex* pindexNew)
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
-    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
+    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%.1fMiB(%utx)\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble()) / log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
-        Checkpoints::GuessVerificationProgress(chainActive.Tip()), (unsigned int)pcoinsTip->GetCacheSize());
+        Checkpoints::GuessVerificationProgress(chainActive.Tip()), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)), (unsigned int)pcoinsTip->GetCacheSize());
 
     cvBlockChange.notify_all();
 
@@ -3554,6 +3837,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
                         pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
             }
             // Notify external listeners about the new tip.
+            GetMainSignals().UpdatedBlockTip(pindexNewTip);
             uiInterface.NotifyBlockTip(hashNewTip);
         }
     } while (pindexMostWork != chainActive.Tip());
@@ -3965,15 +4249,17 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // Check transactions
     bool fZerocoinActive = true;
     vector<CBigNum> vBlockSerials;
+    std::vector<CZerocoinSpendCheck> vZerocoinChecks;
     for (const CTransaction& tx : block.vtx) {
-        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_StartHeight(), state))
+        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_StartHeight(), state, nScriptCheckThreads ? &vZerocoinChecks : NULL))
             return error("CheckBlock() : CheckTransaction failed");
 
         // double check that there are no double spent zBIT spends in this block
         if (tx.IsZerocoinSpend()) {
-            for (const CTxIn txIn : tx.vin) {
-                if (txIn.scriptSig.IsZerocoinSpend()) {
-                    libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
+            for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+                if (tx.vin[nIn].scriptSig.IsZerocoinSpend()) {
+                    boost::shared_ptr<const libzerocoin::CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+                    const libzerocoin::CoinSpend& spend = *pspend;
                     if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
                         return state.DoS(100, error("%s : Double spending of zBIT serial %s in block\n Block: %s",
                                                     __func__, spend.getCoinSerialNumber().GetHex(), block.ToString()));
@@ -3983,6 +4269,19 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         }
     }
 
+    // Verify the proofs of all zerocoin spends in the block concurrently
+    if (!vZerocoinChecks.empty()) {
+        LOCK(cs_zerocoinspendcheck);
+        CCheckQueueControl<CZerocoinSpendCheck> control(&zerocoinspendcheckqueue);
+        control.Add(vZerocoinChecks);
+        if (!control.Wait()) {
+            // Score the failure exactly as the inline path in CheckZerocoinSpend and CheckTransaction does
+            state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+            state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
+            return error("CheckBlock() : CheckTransaction failed");
+        }
+    }
+
 
     unsigned int nSigOps = 0;
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
@@ -4472,9 +4771,13 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB()
 {
+    int64_t nTimeStart = GetTimeMillis();
     if (!pblocktree->LoadBlockIndexGuts())
         return false;
 
+    int64_t nTimeGuts = GetTimeMillis();
+    LogPrintf("%s: loaded %u block index entries in %dms\n", __func__, mapBlockIndex.size(), nTimeGuts - nTimeStart);
+
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
@@ -4510,6 +4813,9 @@ bool static LoadBlockIndexDB()
             pindexBestHeader = pindex;
     }
 
+    int64_t nTimeChainWork = GetTimeMillis();
+    LogPrintf("%s: calculated chain work in %dms\n", __func__, nTimeChainWork - nTimeGuts);
+
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
@@ -4542,6 +4848,7 @@ bool static LoadBlockIndexDB()
             return false;
         }
     }
+    LogPrintf("%s: checked block files in %dms\n", __func__, GetTimeMillis() - nTimeChainWork);
 
     //Check if the shutdown procedure was followed on last client exit
     bool fLastShutdownWasPrepared = true;
@@ -4706,7 +5013,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -4907,6 +5214,7 @@ void static CheckBlockIndex()
     }
 
     LOCK(cs_main);
+    int64_t nTimeStart = GetTimeMillis();
 
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
@@ -5041,6 +5349,8 @@ void static CheckBlockIndex()
 
     // Check that we actually traversed the entire map.
     assert(nNodes == forward.size());
+
+    LogPrint("bench", "%s: checked %u block index entries in %dms\n", __func__, nNodes, GetTimeMillis() - nTimeStart);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -5165,6 +5475,54 @@ bool static AlreadyHave(const CInv& inv)
 }
 
 
+namespace
+{
+/**
+ * Recently served getdata replies, each serialized and checksummed once and shared
+ * by every peer that requests the same inventory after it was relayed. Only objects
+ * that never change under their inventory hash may be served from here.
+ */
+class CSharedMessageCache
+{
+private:
+    static const unsigned int MAX_SHARED_MESSAGES = 2000;
+
+    std::map<CInv, CSerializedNetMsg> mapMessages;
+    std::deque<CInv> queueInserted; //! insertion order, oldest entries are evicted first
+    CCriticalSection cs_messages;
+
+public:
+    template <typename T>
+    CSerializedNetMsg Get(const CInv& inv, const char* pszCommand, const T& obj)
+    {
+        {
+            LOCK(cs_messages);
+            std::map<CInv, CSerializedNetMsg>::const_iterator it = mapMessages.find(inv);
+            if (it != mapMessages.end())
+                return it->second;
+        }
+
+        CSerializedNetMsg msg = CreateSerializedNetMsg(pszCommand, obj);
+
+        LOCK(cs_messages);
+        if (mapMessages.insert(std::make_pair(inv, msg)).second) {
+            queueInserted.push_back(inv);
+            if (queueInserted.size() > MAX_SHARED_MESSAGES) {
+                mapMessages.erase(queueInserted.front());
+                queueInserted.pop_front();
+            }
+        }
+        return msg;
+    }
+};
+
+CSharedMessageCache sharedMessageCache;
+
+//! The last block served, most getdata requests for blocks ask for the new tip
+CSerializedNetMsg msgLastBlock;
+uint256 hashLastBlock = 0;
+} // anon namespace
+
 void static ProcessGetData(CNode* pfrom)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -5202,14 +5560,22 @@ void static ProcessGetData(CNode* pfrom)
                 }
                 // Don't send not-validated blocks
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_BLOCK) {
+                        // Send block from disk, unless it was serialized for an earlier request (cs_main is held)
+                        if (hashLastBlock != inv.hash) {
+                            CBlock block;
+                            if (!ReadBlockFromDisk(block, (*mi).second))
+                                assert(!"cannot load block from disk");
+                            msgLastBlock = CreateSerializedNetMsg("block", block);
+                            hashLastBlock = inv.hash;
+                        }
+                        pfrom->PushSerializedMessage(msgLastBlock);
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second))
+                            assert(!"cannot load block from disk");
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -5245,9 +5611,9 @@ void static ProcessGetData(CNode* pfrom)
                 bool pushed = false;
                 {
                     LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
+                    map<CInv, CSerializedNetMsg>::iterator mi = mapRelay.find(inv);
                     if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
+                        pfrom->PushSerializedMessage((*mi).second);
                         pushed = true;
                     }
                 }
@@ -5255,91 +5621,65 @@ void static ProcessGetData(CNode* pfrom)
                 if (!pushed && inv.type == MSG_TX) {
                     CTransaction tx;
                     if (mempool.lookup(inv.hash, tx)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << tx;
-                        pfrom->PushMessage("tx", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "tx", tx));
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
                     if (mapTxLockVote.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
-                        pfrom->PushMessage("txlvote", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "txlvote", mapTxLockVote[inv.hash]));
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
                     if (mapTxLockReq.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
-                        pfrom->PushMessage("ix", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "ix", mapTxLockReq[inv.hash]));
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_SPORK) {
                     if (mapSporks.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
-                        pfrom->PushMessage("spork", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "spork", mapSporks[inv.hash]));
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
                     if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
-                        pfrom->PushMessage("mnw", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "mnw", masternodePayments.mapMasternodePayeeVotes[inv.hash]));
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_BUDGET_VOTE) {
                     if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
-                        pfrom->PushMessage("mvote", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "mvote", budget.mapSeenMasternodeBudgetVotes[inv.hash]));
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
                     if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetProposals[inv.hash];
-                        pfrom->PushMessage("mprop", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "mprop", budget.mapSeenMasternodeBudgetProposals[inv.hash]));
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
                     if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
-                        pfrom->PushMessage("fbvote", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "fbvote", budget.mapSeenFinalizedBudgetVotes[inv.hash]));
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
                     if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
-                        pfrom->PushMessage("fbs", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "fbs", budget.mapSeenFinalizedBudgets[inv.hash]));
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
                     if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+                        // Not shared: the lastPing of a seen broadcast is updated in place under the same hash
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
                         ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
@@ -5350,10 +5690,7 @@ void static ProcessGetData(CNode* pfrom)
 
                 if (!pushed && inv.type == MSG_MASTERNODE_PING) {
                     if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodePing[inv.hash];
-                        pfrom->PushMessage("mnp", ss);
+                        pfrom->PushSerializedMessage(sharedMessageCache.Get(inv, "mnp", mnodeman.mapSeenMasternodePing[inv.hash]));
                         pushed = true;
                     }
                 }
@@ -5913,6 +6250,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Hash the headers before taking cs_main, old XEVAN headers are spread over the header hash workers
+        std::vector<uint256> vHashes;
+        GetBlockHeaderHashes(headers, vHashes);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -5920,13 +6261,21 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             return true;
         }
         CBlockIndex* pindexLast = NULL;
-        BOOST_FOREACH (const CBlockHeader& header, headers) {
+        for (unsigned int n = 0; n < headers.size(); n++) {
+            const CBlockHeader& header = headers[n];
             CValidationState state;
             if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
 
+            // Headers we already have only need their index entry
+            BlockMap::iterator mi = mapBlockIndex.find(vHashes[n]);
+            if (mi != mapBlockIndex.end() && !(mi->second->nStatus & BLOCK_FAILED_MASK)) {
+                pindexLast = mi->second;
+                continue;
+            }
+
             /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
              * before headers are reimplemented on mainnet
              */
@@ -5935,7 +6284,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 if (state.IsInvalid(nDoS)) {
                     if (nDoS > 0)
                         Misbehaving(pfrom->GetId(), nDoS);
-                    std::string strError = "invalid header received " + header.GetHash().ToString();
+                    std::string strError = "invalid header received " + vHashes[n].ToString();
                     return error(strError.c_str());
                 }
             }
@@ -6321,6 +6670,8 @@ bool ProcessMessages(CNode* pfrom)
 
         // Process message
         bool fRet = false;
+        int64_t nTimeStart = GetTimeMicros();
+        int64_t nMainWaitStart = GetThreadLockWait();
         try {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
             boost::this_thread::interruption_point();
@@ -6342,6 +6693,8 @@ bool ProcessMessages(CNode* pfrom)
         } catch (...) {
             PrintExceptionContinue(NULL, "ProcessMessages()");
         }
+        pfrom->RecordMessageRecv(strCommand, CMessageHeader::HEADER_SIZE + nMessageSize,
+            GetTimeMicros() - nTimeStart, GetThreadLockWait() - nMainWaitStart);
 
         if (!fRet)
             LogPrintf("ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->id);
@@ -43,6 +43,7 @@
 
 #include "libzerocoin/CoinSpend.h"
 
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
@@ -53,6 +54,7 @@ class CBloomFilter;
 class CInv;
 class CScriptCheck;
 class CValidationInterface;
+class CZerocoinSpendCheck;
 class CValidationState;
 
 struct CBlockTemplate;
@@ -122,6 +124,12 @@ static const unsigned int MAX_TX_SIGOPS_CURRENT = MAX_BLOCK_SIGOPS_CURRENT / 5;
 static const unsigned int MAX_TX_SIGOPS_LEGACY = MAX_BLOCK_SIGOPS_LEGACY / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** The maximum number of parsed zerocoin spends kept for reuse between mempool, miner and block validation */
+static const unsigned int MAX_ZEROCOIN_SPEND_CACHE = 1000;
+/** Number of blocks the money supply recalculation decodes ahead of the block it applies */
+static const unsigned int MONEY_SUPPLY_DECODE_AHEAD = 256;
+/** Number of recalculated block index entries written per batch */
+static const unsigned int MONEY_SUPPLY_BATCH_SIZE = 1000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -187,7 +195,7 @@ extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
-extern unsigned int nCoinCacheSize;
+extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 extern bool fVerifyingBlocks;
@@ -265,6 +273,8 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the zerocoin spend checking thread */
+void ThreadZerocoinSpendCheck();
 
 // ***TODO*** probably not the right place for these 2
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
@@ -396,13 +406,17 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
 /** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state);
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvZerocoinChecks = NULL);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
-bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state);
+bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks = NULL);
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin);
+/** Parsed zerocoin spend of input nIn of tx, shared through a bounded cache of recently seen spends */
+boost::shared_ptr<const libzerocoin::CoinSpend> GetZerocoinSpend(const CTransaction& tx, unsigned int nIn);
 bool TxOutToPublicCoin(const CTxOut txout, libzerocoin::PublicCoin& pubCoin, CValidationState& state);
 bool BlockToPubcoinList(const CBlock& block, list<libzerocoin::PublicCoin>& listPubcoins);
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints);
+bool BlockIndexToPubcoinList(const CBlockIndex* pindex, std::list<libzerocoin::PublicCoin>& listPubcoins, libzerocoin::CoinDenomination denom = libzerocoin::ZQ_ERROR);
+bool ReindexZerocoinPubcoins();
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
 std::list<libzerocoin::CoinDenomination> ZerocoinSpendListFromBlock(const CBlock& block);
 void FindMints(vector<CZerocoinMint> vMintsToFind, vector<CZerocoinMint>& vMintsToUpdate, vector<CZerocoinMint>& vMissingMints, bool fExtendedSearch);
@@ -413,9 +427,11 @@ bool RemoveSerialFromDB(const CBigNum& bnSerial);
 int GetZerocoinStartHeight();
 bool IsTransactionInChain(uint256 txId, int& nHeightTx);
 bool IsBlockHashInChain(const uint256& hashBlock);
-void RecalculateZBitMoneySpent();
-void RecalculateZBitMoneyMinted();
-bool RecalculateBitMoneySupply(int nHeightStart);
+/**
+ * Recompute the zBIT mint list, zBIT supply and money supply of every block from nHeightStart
+ * to the tip. Progress is committed with the block index, see CBlockTreeDB::ReadMoneySupplyProgress.
+ */
+bool RecalculateMoneySupply(int nHeightStart);
 
 
 /**
@@ -487,6 +503,34 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof verification of one zerocoin spend
+ * (accumulator proof, serial number signature of knowledge and commitment proofs)
+ */
+class CZerocoinSpendCheck
+{
+private:
+    boost::shared_ptr<const libzerocoin::CoinSpend> pspend;
+    CBigNum bnAccumulatorValue;
+    uint256 hashTx;
+    unsigned int nIn;
+
+public:
+    CZerocoinSpendCheck() : bnAccumulatorValue(0), hashTx(0), nIn(0) {}
+    CZerocoinSpendCheck(const boost::shared_ptr<const libzerocoin::CoinSpend>& pspendIn, const CBigNum& bnAccumulatorValueIn, const uint256& hashTxIn, unsigned int nInIn) : pspend(pspendIn),
+                                                                                                                           bnAccumulatorValue(bnAccumulatorValueIn), hashTx(hashTxIn), nIn(nInIn) {}
+
+    bool operator()();
+
+    void swap(CZerocoinSpendCheck& check)
+    {
+        pspend.swap(check.pspend);
+        std::swap(bnAccumulatorValue, check.bnAccumulatorValue);
+        std::swap(hashTx, check.hashTx);
+        std::swap(nIn, check.nIn);
+    }
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos);
@@ -13,48 +13,51 @@
 
 // keep track of the scanning errors I've seen
 map<uint256, int> mapSeenMasternodeScanningErrors;
-// cache block hashes as we calculate them
-std::map<int64_t, uint256> mapCacheBlockHashes;
-
-//Get the last hash that matches the modulus given. Processed in reverse order
+// recently looked up block hashes by height, only valid for the tip they were looked up from
+struct CBlockHashCacheEntry {
+    const CBlockIndex* pindexTip;
+    int nHeight;
+    uint256 hash;
+};
+static const int BLOCK_HASH_CACHE_SIZE = 256;
+static CBlockHashCacheEntry vBlockHashCache[BLOCK_HASH_CACHE_SIZE];
+static CCriticalSection cs_vBlockHashCache;
+
+//Get the last hash that matches the modulus given. Processed in reverse order: the hash returned for
+//nBlockHeight is the hash of block nBlockHeight - 1 of the active chain, and 0 means the tip height
 bool GetBlockHash(uint256& hash, int nBlockHeight)
 {
-    if (chainActive.Tip() == NULL) return false;
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (pindexTip == NULL) return false;
 
     if (nBlockHeight == 0)
-        nBlockHeight = chainActive.Tip()->nHeight;
-
-    if (mapCacheBlockHashes.count(nBlockHeight)) {
-        hash = mapCacheBlockHashes[nBlockHeight];
-        return true;
-    }
-
-    const CBlockIndex* BlockLastSolved = chainActive.Tip();
-    const CBlockIndex* BlockReading = chainActive.Tip();
+        nBlockHeight = pindexTip->nHeight;
 
-    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 || chainActive.Tip()->nHeight + 1 < nBlockHeight) return false;
+    if (pindexTip->nHeight == 0 || pindexTip->nHeight + 1 < nBlockHeight) return false;
 
-    int nBlocksAgo = 0;
-    if (nBlockHeight > 0) nBlocksAgo = (chainActive.Tip()->nHeight + 1) - nBlockHeight;
-    assert(nBlocksAgo >= 0);
+    int nHeightHash = nBlockHeight > 0 ? nBlockHeight - 1 : pindexTip->nHeight;
+    if (nHeightHash <= 0) return false;
 
-    int n = 0;
-    for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
-        if (n >= nBlocksAgo) {
-            hash = BlockReading->GetBlockHash();
-            mapCacheBlockHashes[nBlockHeight] = hash;
+    CBlockHashCacheEntry& entry = vBlockHashCache[nHeightHash % BLOCK_HASH_CACHE_SIZE];
+    {
+        LOCK(cs_vBlockHashCache);
+        if (entry.pindexTip == pindexTip && entry.nHeight == nHeightHash) {
+            hash = entry.hash;
             return true;
         }
-        n++;
-
-        if (BlockReading->pprev == NULL) {
-            assert(BlockReading);
-            break;
-        }
-        BlockReading = BlockReading->pprev;
     }
 
-    return false;
+    // walk the skip list of the tip rather than chainActive[], which may be resized under cs_main
+    const CBlockIndex* pindex = pindexTip->GetAncestor(nHeightHash);
+    if (pindex == NULL) return false;
+    hash = pindex->GetBlockHash();
+
+    LOCK(cs_vBlockHashCache);
+    entry.pindexTip = pindexTip;
+    entry.nHeight = nHeightHash;
+    entry.hash = hash;
+
+    return true;
 }
 
 CMasternode::CMasternode()
@@ -165,19 +168,25 @@ uint256 CMasternode::CalculateScore(int mod, int64_t nBlockHeight)
     if (chainActive.Tip() == NULL) return 0;
 
     uint256 hash = 0;
-    uint256 aux = vin.prevout.hash + vin.prevout.n;
 
     if (!GetBlockHash(hash, nBlockHeight)) {
         LogPrint("masternode","CalculateScore ERROR - nHeight %d - Returned 0\n", nBlockHeight);
         return 0;
     }
 
+    return CalculateScoreForBlock(hash);
+}
+
+uint256 CMasternode::CalculateScoreForBlock(const uint256& hashBlock) const
+{
+    uint256 aux = vin.prevout.hash + vin.prevout.n;
+
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    ss << hash;
+    ss << hashBlock;
     uint256 hash2 = ss.GetHash();
 
     CHashWriter ss2(SER_GETHASH, PROTOCOL_VERSION);
-    ss2 << hash;
+    ss2 << hashBlock;
     ss2 << aux;
     uint256 hash3 = ss2.GetHash();
 
@@ -542,6 +551,8 @@ bool CMasternodeBroadcast::CheckAndUpdate(int& nDos)
         //take the newest entry
         LogPrint("masternode","mnb - Got updated entry for %s\n", vin.prevout.hash.ToString());
         if (pmn->UpdateFromNewBroadcast((*this))) {
+            mnodeman.RebuildIndexes();
+            mnodeman.ClearRankTables();
             pmn->Check();
             if (pmn->IsEnabled()) Relay();
         }
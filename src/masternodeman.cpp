@@ -193,11 +193,36 @@ void DumpMasternodes()
     LogPrint("masternode","Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
+CMasternodeOutPointHasher::CMasternodeOutPointHasher() : salt(GetRandHash()) {}
+
 CMasternodeMan::CMasternodeMan()
 {
     nDsqCount = 0;
 }
 
+static uint256 PayeeIndexKey(const CScript& payee)
+{
+    return Hash(payee.begin(), payee.end());
+}
+
+void CMasternodeMan::AddToIndexes(size_t nIndex)
+{
+    const CMasternode& mn = vMasternodes[nIndex];
+    mapIndexVin.insert(make_pair(mn.vin.prevout, nIndex));
+    mapIndexPayee.insert(make_pair(PayeeIndexKey(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID())), nIndex));
+    mapIndexPubKey.insert(make_pair(mn.pubKeyMasternode.GetHash(), nIndex));
+}
+
+void CMasternodeMan::RebuildIndexes()
+{
+    LOCK(cs);
+    mapIndexVin.clear();
+    mapIndexPayee.clear();
+    mapIndexPubKey.clear();
+    for (size_t i = 0; i < vMasternodes.size(); i++)
+        AddToIndexes(i);
+}
+
 bool CMasternodeMan::Add(CMasternode& mn)
 {
     LOCK(cs);
@@ -209,6 +234,8 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        AddToIndexes(vMasternodes.size() - 1);
+        ClearRankTables();
         return true;
     }
 
@@ -247,6 +274,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
+    bool fRemoved = false;
     vector<CMasternode>::iterator it = vMasternodes.begin();
     while (it != vMasternodes.end()) {
         if ((*it).activeState == CMasternode::MASTERNODE_REMOVE ||
@@ -279,11 +307,17 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             }
 
             it = vMasternodes.erase(it);
+            fRemoved = true;
         } else {
             ++it;
         }
     }
 
+    if (fRemoved) {
+        RebuildIndexes();
+        ClearRankTables();
+    }
+
     // check who's asked for the Masternode list
     map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.begin();
     while (it1 != mAskedUsForMasternodeList.end()) {
@@ -340,6 +374,10 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    mapIndexVin.clear();
+    mapIndexPayee.clear();
+    mapIndexPubKey.clear();
+    ClearRankTables();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -438,11 +476,19 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
-    CScript payee2;
 
+    boost::unordered_map<uint256, size_t, CCoinsKeyHasher>::const_iterator it = mapIndexPayee.find(PayeeIndexKey(payee));
+    if (it == mapIndexPayee.end())
+        return NULL;
+
+    CMasternode& mn = vMasternodes[it->second];
+    if (GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
+        return &mn;
+
+    // the collateral key changed behind our back, fall back to a full scan
+    RebuildIndexes();
     BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        payee2 = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
-        if (payee2 == payee)
+        if (GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
             return &mn;
     }
     return NULL;
@@ -452,11 +498,11 @@ CMasternode* CMasternodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<COutPoint, size_t, CMasternodeOutPointHasher>::const_iterator it = mapIndexVin.find(vin.prevout);
+    if (it == mapIndexVin.end())
+        return NULL;
+
+    return &vMasternodes[it->second];
 }
 
 
@@ -464,6 +510,16 @@ CMasternode* CMasternodeMan::Find(const CPubKey& pubKeyMasternode)
 {
     LOCK(cs);
 
+    boost::unordered_map<uint256, size_t, CCoinsKeyHasher>::const_iterator it = mapIndexPubKey.find(pubKeyMasternode.GetHash());
+    if (it == mapIndexPubKey.end())
+        return NULL;
+
+    CMasternode& mn = vMasternodes[it->second];
+    if (mn.pubKeyMasternode == pubKeyMasternode)
+        return &mn;
+
+    // the masternode key changed behind our back, fall back to a full scan
+    RebuildIndexes();
     BOOST_FOREACH (CMasternode& mn, vMasternodes) {
         if (mn.pubKeyMasternode == pubKeyMasternode)
             return &mn;
@@ -591,51 +647,88 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+std::shared_ptr<const CMasternodeRankTable> CMasternodeMan::GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, bool fMinAge)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
-    int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
-    int64_t nMasternode_Age = 0;
-
     //make sure we know about this block
     uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    if (!GetBlockHash(hash, nBlockHeight)) return std::shared_ptr<const CMasternodeRankTable>();
 
-    // scan for winner
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.protocolVersion < minProtocol) {
-            LogPrint("masternode","Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
-            continue;                                                       // Skip obsolete versions
-        }
+    // Masternodes re-evaluate their state at most every MASTERNODE_CHECK_SECONDS, so a table is
+    // reused for that long unless the list itself changes
+    pair<uint256, pair<int, int> > key = make_pair(hash, make_pair(minProtocol, (fOnlyActive ? 1 : 0) | (fMinAge ? 2 : 0)));
+    int64_t nNow = GetTime();
+    {
+        LOCK(cs_ranks);
+        std::map<pair<uint256, pair<int, int> >, std::shared_ptr<const CMasternodeRankTable> >::iterator it = mapRankTables.find(key);
+        if (it != mapRankTables.end() && nNow - it->second->nTimeCreated < MASTERNODE_CHECK_SECONDS)
+            return it->second;
+    }
 
-        if (IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
-            nMasternode_Age = GetAdjustedTime() - mn.sigTime;
-            if ((nMasternode_Age) < nMasternode_Min_Age) {
-                if (fDebug) LogPrint("masternode","Skipping just activated Masternode. Age: %ld\n", nMasternode_Age);
-                continue;                                                   // Skip masternodes younger than (default) 1 hour
+    std::shared_ptr<CMasternodeRankTable> ptable = std::make_shared<CMasternodeRankTable>();
+    ptable->nTimeCreated = nNow;
+    {
+        LOCK(cs);
+
+        int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
+        int64_t nMasternode_Age = 0;
+        bool fCheckAge = fMinAge && IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT);
+
+        ptable->vScores.reserve(vMasternodes.size());
+        BOOST_FOREACH (CMasternode& mn, vMasternodes) {
+            if (mn.protocolVersion < minProtocol) {
+                LogPrint("masternode","Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
+                continue;                                                       // Skip obsolete versions
             }
-        }
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
 
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
+            if (fCheckAge) {
+                nMasternode_Age = GetAdjustedTime() - mn.sigTime;
+                if ((nMasternode_Age) < nMasternode_Min_Age) {
+                    if (fDebug) LogPrint("masternode","Skipping just activated Masternode. Age: %ld\n", nMasternode_Age);
+                    continue;                                                   // Skip masternodes younger than (default) 1 hour
+                }
+            }
+            if (fOnlyActive) {
+                mn.Check();
+                if (!mn.IsEnabled()) continue;
+            }
+            uint256 n = mn.CalculateScoreForBlock(hash);
+            int64_t n2 = n.GetCompact(false);
+
+            ptable->vScores.push_back(make_pair(n2, mn.vin));
+        }
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    sort(ptable->vScores.rbegin(), ptable->vScores.rend(), CompareScoreTxIn());
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
-        rank++;
-        if (s.second.prevout == vin.prevout) {
-            return rank;
+    for (unsigned int i = 0; i < ptable->vScores.size(); i++)
+        ptable->mapRanks[ptable->vScores[i].second.prevout] = i + 1;
+
+    LOCK(cs_ranks);
+    std::map<pair<uint256, pair<int, int> >, std::shared_ptr<const CMasternodeRankTable> >::iterator it = mapRankTables.begin();
+    while (it != mapRankTables.end()) {
+        if (nNow - it->second->nTimeCreated >= MASTERNODE_CHECK_SECONDS) {
+            mapRankTables.erase(it++);
+        } else {
+            ++it;
         }
     }
+    mapRankTables[key] = ptable;
 
-    return -1;
+    return ptable;
+}
+
+void CMasternodeMan::ClearRankTables()
+{
+    LOCK(cs_ranks);
+    mapRankTables.clear();
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    std::shared_ptr<const CMasternodeRankTable> ptable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive, true);
+    if (!ptable) return -1;
+
+    return ptable->GetRank(vin);
 }
 
 std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
@@ -644,8 +737,10 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
     std::vector<pair<int, CMasternode> > vecMasternodeRanks;
 
     //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return vecMasternodeRanks;
+    std::shared_ptr<const CMasternodeRankTable> ptable = GetRankTable(nBlockHeight, minProtocol, false, false);
+    if (!ptable) return vecMasternodeRanks;
+
+    LOCK(cs);
 
     // scan for winner
     BOOST_FOREACH (CMasternode& mn, vMasternodes) {
@@ -653,15 +748,13 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
 
         if (mn.protocolVersion < minProtocol) continue;
 
-        if (!mn.IsEnabled()) {
+        int nRank = ptable->GetRank(mn.vin);
+        if (!mn.IsEnabled() || nRank == -1) {
             vecMasternodeScores.push_back(make_pair(9999, mn));
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(make_pair(n2, mn));
+        vecMasternodeScores.push_back(make_pair(ptable->vScores[nRank - 1].first, mn));
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
@@ -677,33 +770,10 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
-
-    // scan for winner
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
+    std::shared_ptr<const CMasternodeRankTable> ptable = GetRankTable(nBlockHeight, minProtocol, fOnlyActive, false);
+    if (!ptable || nRank < 1 || nRank > (int)ptable->vScores.size()) return NULL;
 
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
-    }
-
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
-        rank++;
-        if (rank == nRank) {
-            return Find(s.second);
-        }
-    }
-
-    return NULL;
+    return Find(ptable->vScores[nRank - 1].second);
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -948,6 +1018,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                         pmn->addr = addr;
                         //fake ping
                         pmn->lastPing = CMasternodePing(vin);
+                        RebuildIndexes();
+                        ClearRankTables();
                     }
                     pmn->nLastDsee = sigTime;
                     pmn->Check();
@@ -1140,6 +1212,8 @@ void CMasternodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
             vMasternodes.erase(it);
+            RebuildIndexes();
+            ClearRankTables();
             break;
         }
         ++it;
@@ -1161,6 +1235,8 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
             masternodeSync.AddedMasternodeList(mnb.GetHash());
         }
     } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+        RebuildIndexes();
+        ClearRankTables();
         masternodeSync.AddedMasternodeList(mnb.GetHash());
     }
 }
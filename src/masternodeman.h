@@ -14,6 +14,10 @@
 #include "sync.h"
 #include "util.h"
 
+#include <memory>
+
+#include <boost/unordered_map.hpp>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
 
@@ -48,6 +52,39 @@ public:
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+/** Salted hasher for the collateral outpoint index of the masternode list
+ */
+class CMasternodeOutPointHasher
+{
+private:
+    uint256 salt;
+
+public:
+    CMasternodeOutPointHasher();
+
+    size_t operator()(const COutPoint& out) const
+    {
+        return out.hash.GetHash(salt) + out.n;
+    }
+};
+
+/** Masternode scores for one block, best score first, as handed out by the rank functions
+ */
+class CMasternodeRankTable
+{
+public:
+    int64_t nTimeCreated;
+    std::vector<pair<int64_t, CTxIn> > vScores;
+    std::map<COutPoint, int> mapRanks;
+
+    /// Rank of a masternode (1 = best), -1 if it is not in the table
+    int GetRank(const CTxIn& vin) const
+    {
+        std::map<COutPoint, int>::const_iterator it = mapRanks.find(vin.prevout);
+        return it == mapRanks.end() ? -1 : it->second;
+    }
+};
+
 class CMasternodeMan
 {
 private:
@@ -66,6 +103,22 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // positions in vMasternodes by collateral outpoint, payee script hash and masternode pubkey hash
+    boost::unordered_map<COutPoint, size_t, CMasternodeOutPointHasher> mapIndexVin;
+    boost::unordered_map<uint256, size_t, CCoinsKeyHasher> mapIndexPayee;
+    boost::unordered_map<uint256, size_t, CCoinsKeyHasher> mapIndexPubKey;
+
+    /// Add the entry at position nIndex of vMasternodes to the indexes, keeping earlier entries for duplicate keys
+    void AddToIndexes(size_t nIndex);
+
+    // critical section to protect the rank tables
+    mutable CCriticalSection cs_ranks;
+    // rank tables by (block hash, (minProtocol, filter flags)), dropped whenever the list changes
+    std::map<pair<uint256, pair<int, int> >, std::shared_ptr<const CMasternodeRankTable> > mapRankTables;
+
+    /// Get (or build) the rank table of a block for the given filters
+    std::shared_ptr<const CMasternodeRankTable> GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, bool fMinAge);
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -89,6 +142,9 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+
+        if (ser_action.ForRead())
+            RebuildIndexes();
     }
 
     CMasternodeMan();
@@ -109,6 +165,12 @@ public:
     /// Clear Masternode vector
     void Clear();
 
+    /// Rebuild the vin, payee and pubkey indexes, needed after entries were removed or changed their keys
+    void RebuildIndexes();
+
+    /// Drop all cached rank tables
+    void ClearRankTables();
+
     int CountEnabled(int protocolVersion = -1);
 
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
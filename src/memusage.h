@@ -0,0 +1,39 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMUSAGE_H
+#define BITCOIN_MEMUSAGE_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace memusage
+{
+/**
+ * Compute the total memory used by allocating alloc bytes, including the
+ * bookkeeping of the (glibc-style) malloc implementation.
+ */
+static inline size_t MallocUsage(size_t alloc)
+{
+    // Measured on libc6 2.19 on Linux.
+    if (alloc == 0) {
+        return 0;
+    } else if (sizeof(void*) == 8) {
+        return ((alloc + 31) >> 4) << 4;
+    } else if (sizeof(void*) == 4) {
+        return ((alloc + 15) >> 3) << 3;
+    } else {
+        return alloc;
+    }
+}
+
+/** Dynamic memory usage of a vector, not counting what its elements point to */
+template <typename X, typename A>
+static inline size_t DynamicUsage(const std::vector<X, A>& v)
+{
+    return MallocUsage(v.capacity() * sizeof(X));
+}
+}
+
+#endif // BITCOIN_MEMUSAGE_H
@@ -20,6 +20,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet.h"
 #endif
@@ -321,9 +322,10 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
                     continue;
 
                 bool fDoubleSerial = false;
-                for (const CTxIn txIn : tx.vin) {
-                    if (txIn.scriptSig.IsZerocoinSpend()) {
-                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
+                for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+                    if (tx.vin[nIn].scriptSig.IsZerocoinSpend()) {
+                        boost::shared_ptr<const libzerocoin::CoinSpend> pspend = GetZerocoinSpend(tx, nIn);
+                        const libzerocoin::CoinSpend& spend = *pspend;
                         if (!spend.HasValidSerial(Params().Zerocoin_Params()))
                             fDoubleSerial = true;
                         if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
@@ -507,6 +509,53 @@ bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
 
 bool fGenerateBitcoins = false;
 
+/**
+ * Wakes the stake minter as soon as a new tip is connected, so that the kernel search
+ * for it does not wait out a polling interval. It is registered once and never destroyed,
+ * since validation signals may still be in flight on other threads when the minter exits.
+ */
+class CStakeWakeup : public CValidationInterface
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fNewTip;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fNewTip = true;
+        }
+        cond.notify_all();
+    }
+
+public:
+    CStakeWakeup() : fNewTip(false)
+    {
+        RegisterValidationInterface(this);
+    }
+
+    //! The process wide instance, created on first use and intentionally leaked
+    static CStakeWakeup* Get()
+    {
+        static CStakeWakeup* pwakeup = new CStakeWakeup();
+        return pwakeup;
+    }
+
+    //! Sleep until a new tip arrives or nMilliseconds pass, returns whether a tip arrived
+    bool Wait(int64_t nMilliseconds)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fNewTip)
+            cond.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(nMilliseconds));
+        bool fRet = fNewTip;
+        fNewTip = false;
+        return fRet;
+    }
+};
+
 // ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
 
 void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
@@ -529,32 +578,38 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
         fMintableCoins = pwallet->MintableCoins();
     }
 
+    // Each tip is searched right away, then again once per hash interval
+    CStakeWakeup* pwakeup = NULL;
+    if (fProofOfStake)
+        pwakeup = CStakeWakeup::Get();
+    const CBlockIndex* pindexLastSearch = NULL;
+    int64_t nLastSearchTime = 0;
+
     while (fGenerateBitcoins || fProofOfStake) {
         if (fProofOfStake) {
             if (chainActive.Tip()->nHeight < Params().LAST_POW_BLOCK()) {
-                MilliSleep(5000);
+                pwakeup->Wait(5000);
                 continue;
             }
 
             while (chainActive.Tip()->nTime < 1525981707 || vNodes.empty() || pwallet->IsLocked() || !fMintableCoins || nReserveBalance >= pwallet->GetBalance() || !masternodeSync.IsSynced()) {
                 nLastCoinStakeSearchInterval = 0;
-                MilliSleep(5000);
-                if (!fGenerateBitcoins && !fProofOfStake)
-                    continue;
+                pwakeup->Wait(5000);
             }
 
-            if (mapHashedBlocks.count(chainActive.Tip()->nHeight)) //search our map of hashed blocks, see if bestblock has been hashed yet
-            {
-                if (GetTime() - mapHashedBlocks[chainActive.Tip()->nHeight] < max(pwallet->nHashInterval, (unsigned int)1)) // wait half of the nHashDrift with max wait of 3 minutes
-                {
-                    MilliSleep(5000);
+            if (chainActive.Tip() == pindexLastSearch) {
+                int64_t nWait = nLastSearchTime + max(pwallet->nHashInterval, (unsigned int)1) * 1000 - GetTimeMillis();
+                if (nWait > 0) {
+                    pwakeup->Wait(nWait);
                     continue;
                 }
             }
+            pindexLastSearch = chainActive.Tip();
+            nLastSearchTime = GetTimeMillis();
+        } else {
+            MilliSleep(1000);
         }
 
-        MilliSleep(1000);
-
         //
         // Create new block
         //
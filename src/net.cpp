@@ -24,6 +24,11 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
 #endif
 
 #ifdef USE_UPNP
@@ -64,8 +69,9 @@ const int MAX_OUTBOUND_CONNECTIONS = 24;
 struct ListenSocket {
     SOCKET socket;
     bool whitelisted;
+    bool fAcceptReady; // a connection may be waiting to be accepted
 
-    ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted) {}
+    ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted), fAcceptReady(false) {}
 };
 }
 
@@ -88,7 +94,7 @@ bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
+map<CInv, CSerializedNetMsg> mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
@@ -107,6 +113,8 @@ CCriticalSection cs_nLastNodeId;
 
 static CSemaphore* semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
+//! Wait for socket events with epoll instead of select (-socketevents)
+static bool fSocketsEpoll = false;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -558,6 +566,10 @@ void CNode::copyStats(CNodeStats& stats)
     X(nSendBytes);
     X(nRecvBytes);
     X(fWhitelisted);
+    {
+        LOCK(cs_msgStats);
+        X(mapMsgStats);
+    }
 
     // It is common for nodes with good ping times to suddenly become lagged,
     // due to a new block arriving or other large transfer.
@@ -665,25 +677,53 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
 
 
 // requires LOCK(cs_vSend)
-void SocketSendData(CNode* pnode)
+bool SocketSendData(CNode* pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSerializedNetMsg>::iterator it = pnode->vSendMsg.begin();
+    bool fWouldBlock = false;
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData& data = *it;
+        const CSerializeData& data = **it;
         assert(data.size() > pnode->nSendOffset);
-        int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+        size_t nWant = data.size() - pnode->nSendOffset;
+        int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], nWant, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+        // Hand as many queued messages as fit in one call to the kernel, straight from vSendMsg
+        struct iovec iov[MAX_SEND_IOV];
+        size_t nWant = 0;
+        int nIov = 0;
+        for (std::deque<CSerializedNetMsg>::iterator itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOV; ++itIov, ++nIov) {
+            size_t nOffset = (nIov == 0) ? pnode->nSendOffset : 0;
+            iov[nIov].iov_base = const_cast<char*>(&(**itIov)[nOffset]);
+            iov[nIov].iov_len = (*itIov)->size() - nOffset;
+            nWant += iov[nIov].iov_len;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = nIov;
+        ssize_t nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                size_t nRemaining = (*it)->size() - pnode->nSendOffset;
+                if (nLeft < nRemaining) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRemaining;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= (*it)->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            if ((size_t)nBytes < nWant) {
+                // could not send everything; the socket buffer is full
+                fWouldBlock = true;
                 break;
             }
         } else {
@@ -696,6 +736,7 @@ void SocketSendData(CNode* pnode)
                 }
             }
             // couldn't send anything at all
+            fWouldBlock = true;
             break;
         }
     }
@@ -705,12 +746,229 @@ void SocketSendData(CNode* pnode)
         assert(pnode->nSendSize == 0);
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    return !fWouldBlock;
+}
+
+/**
+ * Decide what to wait for on a peer's socket:
+ * * If there is data to send, wait for sending data. As this only
+ *   happens when optimistic write failed, we choose to first drain the
+ *   write buffer in this case before receiving more. This avoids
+ *   needlessly queueing received data, if the remote peer is not themselves
+ *   receiving data. This means properly utilizing TCP flow control signalling.
+ * * Otherwise, if there is no (complete) message in the receive buffer,
+ *   or there is space left in the buffer, wait for receiving data.
+ * * (if neither of the above applies, there is certainly one message
+ *   in the receiver buffer ready to be processed).
+ * Together, that means that at least one of the following is always possible,
+ * so we don't deadlock:
+ * * We send some data.
+ * * We wait for data to be received (and disconnect after timeout).
+ * * We process a message in the buffer (message handler thread).
+ */
+static void SocketWantEvents(CNode* pnode, bool& fWantSend, bool& fWantRecv)
+{
+    fWantSend = false;
+    fWantRecv = false;
+    {
+        TRY_LOCK(pnode->cs_vSend, lockSend);
+        if (lockSend && !pnode->vSendMsg.empty()) {
+            fWantSend = true;
+            return;
+        }
+    }
+    {
+        TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+        if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                            pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+            fWantRecv = true;
+    }
+}
+
+/**
+ * Wait up to 50ms for socket events with select(). Only the events we currently
+ * want are selected for, so the readiness flags are recomputed on every call.
+ */
+static void SocketEventsSelect(const vector<CNode*>& vNodesCopy)
+{
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+    }
+
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        FD_SET(pnode->hSocket, &fdsetError);
+        hSocketMax = max(hSocketMax, pnode->hSocket);
+        have_fds = true;
+
+        bool fWantSend, fWantRecv;
+        SocketWantEvents(pnode, fWantSend, fWantRecv);
+        if (fWantSend)
+            FD_SET(pnode->hSocket, &fdsetSend);
+        else if (fWantRecv)
+            FD_SET(pnode->hSocket, &fdsetRecv);
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+        &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    boost::this_thread::interruption_point();
+
+    if (nSelect == SOCKET_ERROR) {
+        if (have_fds) {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecv);
+        }
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        MilliSleep(timeout.tv_usec / 1000);
+    }
+
+    BOOST_FOREACH (ListenSocket& hListenSocket, vhListenSocket)
+        hListenSocket.fAcceptReady = hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv);
+
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        SOCKET hSocket = pnode->hSocket;
+        if (hSocket == INVALID_SOCKET) {
+            pnode->fSocketRecvReady = pnode->fSocketSendReady = false;
+            continue;
+        }
+        pnode->fSocketRecvReady = FD_ISSET(hSocket, &fdsetRecv) || FD_ISSET(hSocket, &fdsetError);
+        pnode->fSocketSendReady = FD_ISSET(hSocket, &fdsetSend);
+    }
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static int hEpoll = -1;
+//! Listening sockets are told apart from peers (tagged by node id) in epoll_event.data.u64
+static const uint64_t EPOLL_LISTEN_TAG = 1ULL << 32;
+static const int MAX_EPOLL_EVENTS = 256;
+
+/**
+ * Wait up to 50ms for socket events with edge-triggered epoll. The kernel only
+ * reports changes, so readiness is remembered on the node and cleared by the
+ * socket thread once a read or write would block. The wait does not block at all
+ * while a socket is known to be ready for something we want to do.
+ */
+static void SocketEventsEpoll(const vector<CNode*>& vNodesCopy)
+{
+    bool fPending = false;
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket)
+        fPending |= hListenSocket.fAcceptReady;
+
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        SOCKET hSocket = pnode->hSocket;
+        if (hSocket == INVALID_SOCKET)
+            continue;
+        if (!pnode->fSocketRegistered) {
+            // The current state of a new socket is reported by the next epoll_wait
+            struct epoll_event event;
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.u64 = pnode->id;
+            if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->id, NetworkErrorString(WSAGetLastError()));
+                pnode->CloseSocketDisconnect();
+                continue;
+            }
+            pnode->fSocketRegistered = true;
+            continue;
+        }
+        bool fWantSend, fWantRecv;
+        SocketWantEvents(pnode, fWantSend, fWantRecv);
+        if ((fWantSend && pnode->fSocketSendReady) || (fWantRecv && pnode->fSocketRecvReady))
+            fPending = true;
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(hEpoll, events, MAX_EPOLL_EVENTS, fPending ? 0 : 50);
+    boost::this_thread::interruption_point();
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            MilliSleep(50);
+        }
+        return;
+    }
+    if (nEvents == 0)
+        return;
+
+    std::map<NodeId, CNode*> mapNodes;
+    BOOST_FOREACH (CNode* pnode, vNodesCopy)
+        mapNodes[pnode->id] = pnode;
+
+    for (int i = 0; i < nEvents; i++) {
+        const uint64_t nTag = events[i].data.u64;
+        const uint32_t nFlags = events[i].events;
+        if (nTag & EPOLL_LISTEN_TAG) {
+            size_t nListen = nTag & ~EPOLL_LISTEN_TAG;
+            if (nListen < vhListenSocket.size())
+                vhListenSocket[nListen].fAcceptReady = true;
+            continue;
+        }
+        // Events of peers that were disconnected in the meantime are dropped
+        std::map<NodeId, CNode*>::iterator it = mapNodes.find((NodeId)nTag);
+        if (it == mapNodes.end())
+            continue;
+        if (nFlags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            it->second->fSocketRecvReady = true;
+        if (nFlags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            it->second->fSocketSendReady = true;
+    }
+}
+
+static bool InitSocketEventsEpoll()
+{
+    hEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (hEpoll < 0) {
+        LogPrintf("epoll_create1 failed: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    for (size_t i = 0; i < vhListenSocket.size(); i++) {
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = EPOLL_LISTEN_TAG | i;
+        if (epoll_ctl(hEpoll, EPOLL_CTL_ADD, vhListenSocket[i].socket, &event) != 0) {
+            LogPrintf("epoll_ctl failed for listening socket: %s\n", NetworkErrorString(WSAGetLastError()));
+            close(hEpoll);
+            hEpoll = -1;
+            return false;
+        }
+        // Connections may have queued up before registration
+        vhListenSocket[i].fAcceptReady = true;
+    }
+    return true;
+}
+#endif
+
 static list<CNode*> vNodesDisconnected;
 
 void ThreadSocketHandler()
 {
+#ifdef HAVE_SYS_EPOLL_H
+    if (fSocketsEpoll && !InitSocketEventsEpoll()) {
+        LogPrintf("Falling back to select() for socket events\n");
+        fSocketsEpoll = false;
+    }
+#endif
     unsigned int nPrevNodeCount = 0;
     while (true) {
         //
@@ -774,89 +1032,29 @@ void ThreadSocketHandler()
             uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
         }
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
+        vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            BOOST_FOREACH (CNode* pnode, vNodes) {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
+            vNodesCopy = vNodes;
+            BOOST_FOREACH (CNode* pnode, vNodesCopy)
+                pnode->AddRef();
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        boost::this_thread::interruption_point();
-
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
+        //
+        // Find which sockets have data to receive
+        //
+#ifdef HAVE_SYS_EPOLL_H
+        if (hEpoll >= 0)
+            SocketEventsEpoll(vNodesCopy);
+        else
+#endif
+            SocketEventsSelect(vNodesCopy);
 
         //
         // Accept new connections
         //
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+        BOOST_FOREACH (ListenSocket& hListenSocket, vhListenSocket) {
+            if (hListenSocket.socket != INVALID_SOCKET && hListenSocket.fAcceptReady) {
                 struct sockaddr_storage sockaddr;
                 socklen_t len = sizeof(sockaddr);
                 SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
@@ -879,7 +1077,8 @@ void ThreadSocketHandler()
                     int nErr = WSAGetLastError();
                     if (nErr != WSAEWOULDBLOCK)
                         LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                } else if (!IsSelectableSocket(hSocket)) {
+                    hListenSocket.fAcceptReady = false;
+                } else if (!fSocketsEpoll && !IsSelectableSocket(hSocket)) {
                     LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
                     CloseSocket(hSocket);
                 } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
@@ -904,13 +1103,6 @@ void ThreadSocketHandler()
         //
         // Service each socket
         //
-        vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy)
-                pnode->AddRef();
-        }
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
             boost::this_thread::interruption_point();
 
@@ -919,7 +1111,9 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            bool fWantSend, fWantRecv;
+            SocketWantEvents(pnode, fWantSend, fWantRecv);
+            if (pnode->fSocketRecvReady && fWantRecv) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
                     {
@@ -932,6 +1126,9 @@ void ThreadSocketHandler()
                             pnode->nLastRecv = GetTime();
                             pnode->nRecvBytes += nBytes;
                             pnode->RecordBytesRecv(nBytes);
+                            // A short read drained the socket; new data raises a new event
+                            if (nBytes < (int)sizeof(pchBuf))
+                                pnode->fSocketRecvReady = false;
                         } else if (nBytes == 0) {
                             // socket closed gracefully
                             if (!pnode->fDisconnect)
@@ -944,6 +1141,8 @@ void ThreadSocketHandler()
                                 if (!pnode->fDisconnect)
                                     LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                                 pnode->CloseSocketDisconnect();
+                            } else if (nErr == WSAEWOULDBLOCK) {
+                                pnode->fSocketRecvReady = false;
                             }
                         }
                     }
@@ -955,10 +1154,11 @@ void ThreadSocketHandler()
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (pnode->fSocketSendReady && fWantSend) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SocketSendData(pnode);
+                // Only this thread clears the flag, so an edge reported meanwhile cannot get lost
+                if (lockSend && !SocketSendData(pnode))
+                    pnode->fSocketSendReady = false;
             }
 
             //
@@ -1572,6 +1772,16 @@ void static Discover(boost::thread_group& threadGroup)
 #endif
 }
 
+bool UseSocketEventsEpoll()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    std::string strSocketEvents = GetArg("-socketevents", "");
+    return strSocketEvents.empty() || strSocketEvents == "epoll";
+#else
+    return false;
+#endif
+}
+
 void StartNode(boost::thread_group& threadGroup)
 {
     uiInterface.InitMessage(_("Loading addresses..."));
@@ -1610,6 +1820,11 @@ void StartNode(boost::thread_group& threadGroup)
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
     // Send and receive from sockets, accept connections
+    std::string strSocketEvents = GetArg("-socketevents", "");
+    fSocketsEpoll = UseSocketEventsEpoll();
+    if (!fSocketsEpoll && !strSocketEvents.empty() && strSocketEvents != "select")
+        LogPrintf("Unsupported -socketevents=%s, using select()\n", strSocketEvents);
+    LogPrintf("Using %s for socket events\n", fSocketsEpoll ? "epoll" : "select");
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
     // Initiate outbound connections from -addnode
@@ -1624,6 +1839,11 @@ void StartNode(boost::thread_group& threadGroup)
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
 
+    // Dump the message profile
+    int64_t nNetProfileInterval = GetArg("-netprofileinterval", 0);
+    if (nNetProfileInterval > 0)
+        threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "netprofile", &DumpNetProfile, nNetProfileInterval * 1000));
+
     // ppcoin:mint proof-of-stake blocks in the background
     if (GetBoolArg("-staking", true))
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "stakemint", &ThreadStakeMinter));
@@ -1660,6 +1880,10 @@ public:
             if (hListenSocket.socket != INVALID_SOCKET)
                 if (!CloseSocket(hListenSocket.socket))
                     LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef HAVE_SYS_EPOLL_H
+        if (hEpoll >= 0)
+            close(hEpoll);
+#endif
 
         // clean up some globals (to help leak detection)
         BOOST_FOREACH (CNode* pnode, vNodes)
@@ -1708,8 +1932,13 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
             vRelayExpiration.pop_front();
         }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
+        // Save original serialized message so newer versions are preserved. It is kept as a
+        // complete message so every peer requesting it gets the same buffer.
+        if (!mapRelay.count(inv)) {
+            CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+            ssMsg << CMessageHeader(inv.GetCommand(), 0) << ss;
+            mapRelay.insert(std::make_pair(inv, CreateSerializedNetMsg(ssMsg)));
+        }
         vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
     }
     LOCK(cs_vNodes);
@@ -1728,6 +1957,7 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
 {
     CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
+    CSerializedNetMsg msg = CreateSerializedNetMsg("ix", tx);
 
     //broadcast the new lock
     LOCK(cs_vNodes);
@@ -1735,7 +1965,7 @@ void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
         if (!relayToAll && !pnode->fRelayTxes)
             continue;
 
-        pnode->PushMessage("ix", tx);
+        pnode->PushSerializedMessage(msg);
     }
 }
 
@@ -1773,6 +2003,77 @@ uint64_t CNode::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+// Node wide message counters, they outlive the peers that contributed to them
+static CCriticalSection cs_netProfile;
+static mapMsgCmdStats mapNetProfile;
+
+static CNetMsgStats& GetMsgStats(mapMsgCmdStats& mapStats, const std::string& strCommand)
+{
+    mapMsgCmdStats::iterator it = mapStats.find(strCommand);
+    if (it != mapStats.end())
+        return it->second;
+    // Peers choose the command strings, don't let them grow the map without bound
+    if (mapStats.size() >= MAX_NETPROFILE_COMMANDS)
+        return mapStats[NETPROFILE_OTHER];
+    return mapStats[strCommand];
+}
+
+static void AddMessageRecv(CNetMsgStats& stats, unsigned int nBytes, int64_t nHandlerTime, int64_t nMainWaitTime)
+{
+    stats.nMsgsRecv++;
+    stats.nBytesRecv += nBytes;
+    stats.nHandlerTime += nHandlerTime;
+    stats.nHandlerTimeMax = std::max(stats.nHandlerTimeMax, nHandlerTime);
+    stats.nMainWaitTime += nMainWaitTime;
+}
+
+void CNode::RecordMessageRecv(const std::string& strCommand, unsigned int nBytes, int64_t nHandlerTime, int64_t nMainWaitTime)
+{
+    {
+        LOCK(cs_msgStats);
+        AddMessageRecv(GetMsgStats(mapMsgStats, strCommand), nBytes, nHandlerTime, nMainWaitTime);
+    }
+    LOCK(cs_netProfile);
+    AddMessageRecv(GetMsgStats(mapNetProfile, strCommand), nBytes, nHandlerTime, nMainWaitTime);
+}
+
+void CNode::RecordMessageSent(const CSerializeData& msg)
+{
+    // Only our own commands end up here, the header is well formed
+    const char* pszCommand = &msg[MESSAGE_START_SIZE];
+    std::string strCommand(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE));
+    {
+        LOCK(cs_msgStats);
+        CNetMsgStats& stats = GetMsgStats(mapMsgStats, strCommand);
+        stats.nMsgsSent++;
+        stats.nBytesSent += msg.size();
+    }
+    LOCK(cs_netProfile);
+    CNetMsgStats& stats = GetMsgStats(mapNetProfile, strCommand);
+    stats.nMsgsSent++;
+    stats.nBytesSent += msg.size();
+}
+
+void GetNetProfile(mapMsgCmdStats& mapStats)
+{
+    LOCK(cs_netProfile);
+    mapStats = mapNetProfile;
+}
+
+void DumpNetProfile()
+{
+    mapMsgCmdStats mapStats;
+    GetNetProfile(mapStats);
+
+    LogPrintf("Network profile (%u commands):\n", mapStats.size());
+    for (mapMsgCmdStats::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        const CNetMsgStats& stats = it->second;
+        LogPrintf("  %-12s recv=%u/%uB sent=%u/%uB handler=%.3fs max=%.2fms cs_main wait=%.3fs\n",
+            SanitizeString(it->first), stats.nMsgsRecv, stats.nBytesRecv, stats.nMsgsSent, stats.nBytesSent,
+            stats.nHandlerTime * 0.000001, stats.nHandlerTimeMax * 0.001, stats.nMainWaitTime * 0.000001);
+    }
+}
+
 void CNode::Fuzz(int nChance)
 {
     if (!fSuccessfullyConnected) return; // Don't fuzz initial handshake
@@ -1928,6 +2229,9 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    fSocketRecvReady = false;
+    fSocketSendReady = false;
+    fSocketRegistered = false;
     hashContinue = 0;
     nStartingHeight = -1;
     fGetAddr = false;
@@ -2030,26 +2334,51 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     if (ssSend.size() == 0)
         return;
 
-    // Set the size
-    unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
-    memcpy((char*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
+    LogPrint("net", "(%d bytes) peer=%d\n", ssSend.size() - CMessageHeader::HEADER_SIZE, id);
 
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    unsigned int nChecksum = 0;
-    memcpy(&nChecksum, &hash, sizeof(nChecksum));
-    assert(ssSend.size() >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+    vSendMsg.push_back(CreateSerializedNetMsg(ssSend));
+    nSendSize += vSendMsg.back()->size();
+    RecordMessageSent(*vSendMsg.back());
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SocketSendData(this);
 
-    LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
+    LEAVE_CRITICAL_SECTION(cs_vSend);
+}
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+void CNode::PushSerializedMessage(const CSerializedNetMsg& msg)
+{
+    LOCK(cs_vSend);
+    LogPrint("net", "sending shared message (%d bytes) peer=%d\n", msg->size() - CMessageHeader::HEADER_SIZE, id);
+
+    vSendMsg.push_back(msg);
+    nSendSize += msg->size();
+    RecordMessageSent(*msg);
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1)
         SocketSendData(this);
+}
 
-    LEAVE_CRITICAL_SECTION(cs_vSend);
+void FinalizeMessageHeader(CDataStream& ss)
+{
+    // Set the size
+    unsigned int nSize = ss.size() - CMessageHeader::HEADER_SIZE;
+    memcpy((char*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size() >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+}
+
+CSerializedNetMsg CreateSerializedNetMsg(CDataStream& ss)
+{
+    FinalizeMessageHeader(ss);
+    boost::shared_ptr<CSerializeData> pdata(new CSerializeData());
+    ss.GetAndClear(*pdata);
+    return pdata;
 }
@@ -29,6 +29,7 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2/signal.hpp>
 
 class CAddrMan;
@@ -60,10 +61,36 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** Maximum number of queued messages handed to the kernel in one send call */
+static const int MAX_SEND_IOV = 64;
+/** Maximum number of distinct commands profiled per peer, further ones are counted as NETPROFILE_OTHER */
+static const size_t MAX_NETPROFILE_COMMANDS = 64;
+/** Bucket for commands beyond MAX_NETPROFILE_COMMANDS */
+static const char* const NETPROFILE_OTHER = "*other*";
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
+/**
+ * A complete network message, header and checksum included. It is immutable once
+ * created, so one serialization of a relayed object can be queued on any number
+ * of peers.
+ */
+typedef boost::shared_ptr<const CSerializeData> CSerializedNetMsg;
+
+/** Fill in payload size and checksum of ss, which starts with CMessageHeader(pszCommand, 0) */
+void FinalizeMessageHeader(CDataStream& ss);
+/** Turn a stream holding a header and payload into a shareable message, ss is cleared */
+CSerializedNetMsg CreateSerializedNetMsg(CDataStream& ss);
+
+template <typename T>
+CSerializedNetMsg CreateSerializedNetMsg(const char* pszCommand, const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CMessageHeader(pszCommand, 0) << obj;
+    return CreateSerializedNetMsg(ss);
+}
+
 void AddOneShot(std::string strDest);
 bool RecvLine(SOCKET hSocket, std::string& strLine);
 void AddressCurrentlyConnected(const CService& addr);
@@ -75,12 +102,37 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grantOu
 void MapPort(bool fUseUPnP);
 unsigned short GetListenPort();
 bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhitelisted = false);
+/** Whether -socketevents selects the epoll backend, which is not bound by FD_SETSIZE */
+bool UseSocketEventsEpoll();
 void StartNode(boost::thread_group& threadGroup);
 bool StopNode();
-void SocketSendData(CNode* pnode);
+/** Send queued data, returns false if the socket could not take all of it */
+bool SocketSendData(CNode* pnode);
 
 typedef int NodeId;
 
+/** Message counters of one command, kept per peer and for the whole node (getnetprofile) */
+class CNetMsgStats
+{
+public:
+    uint64_t nMsgsRecv;
+    uint64_t nBytesRecv;
+    uint64_t nMsgsSent;
+    uint64_t nBytesSent;
+    int64_t nHandlerTime;    // total wall time (in microseconds) spent processing received messages
+    int64_t nHandlerTimeMax; // longest single message
+    int64_t nMainWaitTime;   // part of nHandlerTime spent waiting for cs_main
+
+    CNetMsgStats() : nMsgsRecv(0), nBytesRecv(0), nMsgsSent(0), nBytesSent(0), nHandlerTime(0), nHandlerTimeMax(0), nMainWaitTime(0) {}
+};
+
+typedef std::map<std::string, CNetMsgStats> mapMsgCmdStats;
+
+/** Copy the message counters of all peers, including disconnected ones */
+void GetNetProfile(mapMsgCmdStats& mapStats);
+/** Write the node wide message counters to debug.log (-netprofileinterval) */
+void DumpNetProfile();
+
 // Signals for message handling
 struct CNodeSignals {
     boost::signals2::signal<int()> GetHeight;
@@ -130,7 +182,7 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, CSerializedNetMsg> mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
@@ -168,6 +220,7 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    mapMsgCmdStats mapMsgStats;
 };
 
 
@@ -223,9 +276,14 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializedNetMsg> vSendMsg;
     CCriticalSection cs_vSend;
 
+    // Socket readiness as reported by select/epoll, only used by the socket thread
+    bool fSocketRecvReady;
+    bool fSocketSendReady;
+    bool fSocketRegistered; // added to the epoll set
+
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
@@ -265,6 +323,8 @@ public:
     CSemaphoreGrant grantOutbound;
     CCriticalSection cs_filter;
     CBloomFilter* pfilter;
+    CCriticalSection cs_msgStats;
+    mapMsgCmdStats mapMsgStats;
     int nRefCount;
     NodeId id;
 
@@ -418,6 +478,9 @@ public:
 
     void PushVersion();
 
+    //! Queue a message that was serialized once for several peers
+    void PushSerializedMessage(const CSerializedNetMsg& msg);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -646,6 +709,10 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    // Per command profile
+    void RecordMessageRecv(const std::string& strCommand, unsigned int nBytes, int64_t nHandlerTime, int64_t nMainWaitTime);
+    void RecordMessageSent(const CSerializeData& msg);
 };
 
 class CExplicitNetCleanup
@@ -0,0 +1,195 @@
+// Copyright (c) 2018 The BitMoney developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_POOLALLOC_H
+#define BITCOIN_POOLALLOC_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Arena for the small, equally sized nodes of a node based container such as
+ * boost::unordered_map. Memory is carved from large chunks and freed nodes are
+ * kept on a free list per size class, so a container holding millions of
+ * entries does not pay the malloc overhead for every one of them. Allocations
+ * larger than MAX_NODE_SIZE (e.g. bucket arrays) go to operator new.
+ *
+ * Chunks are only returned to the system by Release(), once every node has
+ * been deallocated again. Not thread safe; the owner must serialize access.
+ */
+class CNodePool
+{
+private:
+    static const size_t NODE_ALIGN = 16;
+    static const size_t MAX_NODE_SIZE = 256;
+    static const size_t CHUNK_SIZE = 256 * 1024;
+
+    struct CFreeNode {
+        CFreeNode* pnext;
+    };
+
+    //! Free lists indexed by node size in units of NODE_ALIGN
+    CFreeNode* vFree[MAX_NODE_SIZE / NODE_ALIGN + 1];
+    std::vector<char*> vChunks;
+    char* pAvailable;
+    size_t nAvailable;
+    size_t nLiveNodes;
+
+    static size_t SizeClass(size_t nBytes) { return (nBytes + NODE_ALIGN - 1) / NODE_ALIGN; }
+
+    CNodePool(const CNodePool&);
+    CNodePool& operator=(const CNodePool&);
+
+public:
+    CNodePool() : pAvailable(NULL), nAvailable(0), nLiveNodes(0)
+    {
+        for (size_t i = 0; i <= MAX_NODE_SIZE / NODE_ALIGN; i++)
+            vFree[i] = NULL;
+    }
+
+    ~CNodePool()
+    {
+        for (size_t i = 0; i < vChunks.size(); i++)
+            ::operator delete(vChunks[i]);
+    }
+
+    void* Allocate(size_t nBytes)
+    {
+        if (nBytes == 0 || nBytes > MAX_NODE_SIZE)
+            return ::operator new(nBytes);
+
+        const size_t nClass = SizeClass(nBytes);
+        nLiveNodes++;
+        if (vFree[nClass] != NULL) {
+            CFreeNode* pnode = vFree[nClass];
+            vFree[nClass] = pnode->pnext;
+            return pnode;
+        }
+        const size_t nSize = nClass * NODE_ALIGN;
+        if (nAvailable < nSize) {
+            // The tail of the previous chunk is too small for this class; it stays unused
+            pAvailable = static_cast<char*>(::operator new(CHUNK_SIZE));
+            nAvailable = CHUNK_SIZE;
+            vChunks.push_back(pAvailable);
+        }
+        void* p = pAvailable;
+        pAvailable += nSize;
+        nAvailable -= nSize;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t nBytes)
+    {
+        if (nBytes == 0 || nBytes > MAX_NODE_SIZE) {
+            ::operator delete(p);
+            return;
+        }
+        const size_t nClass = SizeClass(nBytes);
+        assert(nLiveNodes > 0);
+        nLiveNodes--;
+        CFreeNode* pnode = static_cast<CFreeNode*>(p);
+        pnode->pnext = vFree[nClass];
+        vFree[nClass] = pnode;
+    }
+
+    //! Return all chunks to the system if no node is in use anymore
+    bool Release()
+    {
+        if (nLiveNodes != 0)
+            return false;
+        for (size_t i = 0; i < vChunks.size(); i++)
+            ::operator delete(vChunks[i]);
+        std::vector<char*>().swap(vChunks);
+        for (size_t i = 0; i <= MAX_NODE_SIZE / NODE_ALIGN; i++)
+            vFree[i] = NULL;
+        pAvailable = NULL;
+        nAvailable = 0;
+        return true;
+    }
+
+    //! Memory held by the pool, whether handed out or on a free list
+    size_t DynamicMemoryUsage() const
+    {
+        return vChunks.size() * CHUNK_SIZE + vChunks.capacity() * sizeof(char*);
+    }
+};
+
+/**
+ * Allocator that draws from a CNodePool. A default constructed allocator has
+ * no pool and falls back to operator new, so containers using it can still be
+ * created without one.
+ */
+template <typename T>
+struct pool_allocator {
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef pool_allocator<U> other;
+    };
+
+    CNodePool* pool;
+
+    pool_allocator() throw() : pool(NULL) {}
+    explicit pool_allocator(CNodePool* poolIn) throw() : pool(poolIn) {}
+    template <typename U>
+    pool_allocator(const pool_allocator<U>& a) throw() : pool(a.pool)
+    {
+    }
+
+    T* allocate(size_t n, const void* hint = 0)
+    {
+        if (pool == NULL)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(pool->Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (pool == NULL)
+            ::operator delete(p);
+        else
+            pool->Deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new ((void*)p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p)
+    {
+        p->~U();
+    }
+
+    size_t max_size() const throw() { return size_t(-1) / sizeof(T); }
+
+    T* address(T& x) const { return &x; }
+    const T* address(const T& x) const { return &x; }
+};
+
+template <typename T, typename U>
+bool operator==(const pool_allocator<T>& a, const pool_allocator<U>& b)
+{
+    return a.pool == b.pool;
+}
+
+template <typename T, typename U>
+bool operator!=(const pool_allocator<T>& a, const pool_allocator<U>& b)
+{
+    return a.pool != b.pool;
+}
+
+#endif // BITCOIN_POOLALLOC_H
@@ -13,6 +13,8 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <boost/thread.hpp>
+
 uint256 CBlockHeader::GetHash() const
 {
 	if(nVersion < 4)
@@ -21,6 +23,115 @@ uint256 CBlockHeader::GetHash() const
     return Hash(BEGIN(nVersion), END(nAccumulatorCheckpoint));
 }
 
+/**
+ * Long lived workers for GetBlockHeaderHashes, so a headers message does not
+ * start a thread per core every time it arrives.
+ */
+class CHeaderHashPool
+{
+private:
+    boost::mutex csRun; //! one batch at a time
+    boost::mutex cs;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    boost::thread_group threadGroup;
+    size_t nWorkers;
+    unsigned int nRound;
+    size_t nPending;
+    bool fShutdown;
+
+    const std::vector<CBlockHeader>* pvHeaders;
+    const std::vector<unsigned int>* pvIndexes;
+    std::vector<uint256>* pvHashes;
+    size_t nStride;
+
+    void Worker(size_t nWorker)
+    {
+        RenameThread("BitMoney-hdrhash");
+        unsigned int nRoundDone = 0;
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (true) {
+            while (!fShutdown && nRound == nRoundDone)
+                condWork.wait(lock);
+            if (fShutdown)
+                return;
+            nRoundDone = nRound;
+            if (nWorker >= nStride)
+                continue;
+
+            // every worker hashes its own headers, so the results need no locking
+            lock.unlock();
+            for (size_t i = nWorker; i < pvIndexes->size(); i += nStride) {
+                unsigned int nIndex = (*pvIndexes)[i];
+                (*pvHashes)[nIndex] = (*pvHeaders)[nIndex].GetHash();
+            }
+            lock.lock();
+            if (--nPending == 0)
+                condDone.notify_all();
+        }
+    }
+
+public:
+    CHeaderHashPool() : nWorkers(0), nRound(0), nPending(0), fShutdown(false), pvHeaders(NULL), pvIndexes(NULL), pvHashes(NULL), nStride(0) {}
+
+    ~CHeaderHashPool()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fShutdown = true;
+        }
+        condWork.notify_all();
+        threadGroup.join_all();
+    }
+
+    void Run(const std::vector<CBlockHeader>& vHeaders, const std::vector<unsigned int>& vIndexes, std::vector<uint256>& vHashes, size_t nThreads)
+    {
+        boost::unique_lock<boost::mutex> lockRun(csRun);
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (nWorkers < nThreads)
+            threadGroup.create_thread(boost::bind(&CHeaderHashPool::Worker, this, nWorkers++));
+
+        pvHeaders = &vHeaders;
+        pvIndexes = &vIndexes;
+        pvHashes = &vHashes;
+        nStride = nThreads;
+        nPending = nStride;
+        nRound++;
+        condWork.notify_all();
+        while (nPending > 0)
+            condDone.wait(lock);
+    }
+};
+
+static CHeaderHashPool headerHashPool;
+
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashes, int nThreads)
+{
+    vHashes.resize(vHeaders.size());
+
+    // v4+ headers are a plain double SHA-256, cheaper to hash here than to hand out
+    std::vector<unsigned int> vXevan;
+    for (unsigned int i = 0; i < vHeaders.size(); i++) {
+        if (vHeaders[i].nVersion < 4)
+            vXevan.push_back(i);
+        else
+            vHashes[i] = vHeaders[i].GetHash();
+    }
+
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency();
+    // don't bother waking workers for a handful of headers
+    nThreads = std::min(std::min(nThreads, MAX_HEADER_HASH_THREADS), (int)(vXevan.size() / 64));
+
+    if (nThreads <= 1) {
+        for (unsigned int i : vXevan)
+            vHashes[i] = vHeaders[i].GetHash();
+        return;
+    }
+
+    headerHashPool.Run(vHeaders, vXevan, vHashes, nThreads);
+}
+
 uint256 CBlock::BuildMerkleTree(bool* fMutated) const
 {
     /* WARNING! If you're reading this because you're learning about crypto
@@ -171,6 +171,16 @@ public:
 };
 
 
+/** Upper bound on the workers GetBlockHeaderHashes keeps around */
+static const int MAX_HEADER_HASH_THREADS = 16;
+
+/**
+ * Hash a batch of headers. Old XEVAN (v<4) headers are spread over up to nThreads
+ * pooled workers (0 = one per core), newer ones are hashed on the calling thread.
+ */
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashes, int nThreads = 0);
+
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
@@ -214,6 +214,34 @@ static bool rest_tx(AcceptedConnection* conn,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_netprofile(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& mapHeaders,
+    bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    switch (rf) {
+    case RF_JSON: {
+        // Totals only, the addresses of connected peers are left to the authenticated RPC
+        Array params;
+        params.push_back(false);
+        Value profile = getnetprofile(params, false);
+        string strJSON = write_string(profile, false) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(AcceptedConnection* conn,
@@ -224,6 +252,7 @@ static const struct {
     {"/rest/tx/", rest_tx},
     {"/rest/block/notxdetails/", rest_block_notxdetails},
     {"/rest/block/", rest_block_extended},
+    {"/rest/netprofile", rest_netprofile},
 };
 
 bool HTTPReq_REST(AcceptedConnection* conn,
@@ -28,7 +28,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     {
         {"stop", 0},
         {"setmocktime", 0},
+        {"getlockstats", 0},
         {"getaddednodeinfo", 0},
+        {"getnetprofile", 0},
         {"setgenerate", 0},
         {"setgenerate", 1},
         {"getnetworkhashps", 0},
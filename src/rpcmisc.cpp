@@ -510,6 +510,63 @@ Value setmocktime(const Array& params, bool fHelp)
     return Value::null;
 }
 
+#ifdef DEBUG_LOCKPROFILE
+static bool CompareLockWaitTime(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nWaitTime > b.nWaitTime;
+}
+#endif
+
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getlockstats ( count )\n"
+            "\nReturns acquisition, contention, wait and hold statistics of each LOCK() site,\n"
+            "sorted by total wait time. Requires a build configured with --enable-lockprofile.\n"
+            "\nArguments:\n"
+            "1. count    (numeric, optional) Only return the <count> sites with the highest wait time\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"lock\": \"name\",        (string) The locked critical section, as written at the site\n"
+            "    \"site\": \"file:line\",   (string) Source location of the LOCK()\n"
+            "    \"acquired\": n,         (numeric) Number of acquisitions\n"
+            "    \"contended\": n,        (numeric) Acquisitions that had to wait for another thread\n"
+            "    \"tryfailed\": n,        (numeric) TRY_LOCK attempts that did not get the lock\n"
+            "    \"waittime\": n,         (numeric) Total time spent waiting, in seconds\n"
+            "    \"holdtime\": n          (numeric) Total time the lock was held from this site, in seconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getlockstats", "") + HelpExampleCli("getlockstats", "10") + HelpExampleRpc("getlockstats", "10"));
+
+#ifdef DEBUG_LOCKPROFILE
+    std::vector<CLockSiteStats> vStats;
+    GetLockStats(vStats);
+    std::sort(vStats.begin(), vStats.end(), CompareLockWaitTime);
+    if (params.size() > 0 && params[0].get_int() >= 0 && (size_t)params[0].get_int() < vStats.size())
+        vStats.resize(params[0].get_int());
+
+    Array ret;
+    BOOST_FOREACH (const CLockSiteStats& stats, vStats) {
+        Object obj;
+        obj.push_back(Pair("lock", stats.strName));
+        obj.push_back(Pair("site", strprintf("%s:%d", stats.strFile, stats.nLine)));
+        obj.push_back(Pair("acquired", stats.nAcquired));
+        obj.push_back(Pair("contended", stats.nContended));
+        obj.push_back(Pair("tryfailed", stats.nTryFailed));
+        obj.push_back(Pair("waittime", stats.nWaitTime * 0.000001));
+        obj.push_back(Pair("holdtime", stats.nHoldTime * 0.000001));
+        ret.push_back(obj);
+    }
+    return ret;
+#else
+    throw JSONRPCError(RPC_MISC_ERROR, "Lock profiling is not compiled in, configure with --enable-lockprofile");
+#endif
+}
+
 #ifdef ENABLE_WALLET
 Value getstakingstatus(const Array& params, bool fHelp)
 {
@@ -325,6 +325,85 @@ Value getnettotals(const Array& params, bool fHelp)
     return obj;
 }
 
+static Object NetMsgStatsToJSON(const mapMsgCmdStats& mapStats)
+{
+    Object obj;
+    for (mapMsgCmdStats::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        const CNetMsgStats& stats = it->second;
+        Object entry;
+        entry.push_back(Pair("msgsrecv", stats.nMsgsRecv));
+        entry.push_back(Pair("bytesrecv", stats.nBytesRecv));
+        entry.push_back(Pair("msgssent", stats.nMsgsSent));
+        entry.push_back(Pair("bytessent", stats.nBytesSent));
+        entry.push_back(Pair("handlertime", stats.nHandlerTime * 0.000001));
+        entry.push_back(Pair("handlertimemax", stats.nHandlerTimeMax * 0.000001));
+        entry.push_back(Pair("mainwaittime", stats.nMainWaitTime * 0.000001));
+        obj.push_back(Pair(SanitizeString(it->first), entry));
+    }
+    return obj;
+}
+
+Value getnetprofile(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getnetprofile ( peers )\n"
+            "\nReturns per command message statistics, for the whole node and for each connected peer.\n"
+            "Times are decimal seconds and include time spent waiting for the main lock.\n"
+            "\nArguments:\n"
+            "1. peers    (boolean, optional, default=true) Include the statistics of each connected peer\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"total\": {              (json object) Statistics of all peers since startup, by command\n"
+            "    \"command\": {\n"
+            "      \"msgsrecv\": n,        (numeric) Messages received\n"
+            "      \"bytesrecv\": n,       (numeric) Bytes received, headers included\n"
+            "      \"msgssent\": n,        (numeric) Messages sent\n"
+            "      \"bytessent\": n,       (numeric) Bytes sent, headers included\n"
+            "      \"handlertime\": n,     (numeric) Total time spent processing received messages\n"
+            "      \"handlertimemax\": n,  (numeric) Longest time spent on a single message\n"
+            "      \"mainwaittime\": n     (numeric) Part of handlertime spent waiting for cs_main\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"peers\": [             (json array) Connected peers\n"
+            "    {\n"
+            "      \"id\": n,             (numeric) Peer index\n"
+            "      \"addr\": \"host:port\", (string) The ip address and port of the peer\n"
+            "      \"commands\": { ... }  (json object) Statistics of this peer, same format as total\n"
+            "    },\n"
+            "    ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getnetprofile", "") + HelpExampleCli("getnetprofile", "false") + HelpExampleRpc("getnetprofile", "false"));
+
+    bool fPeers = true;
+    if (params.size() > 0)
+        fPeers = params[0].get_bool();
+
+    mapMsgCmdStats mapTotal;
+    GetNetProfile(mapTotal);
+
+    Object ret;
+    ret.push_back(Pair("total", NetMsgStatsToJSON(mapTotal)));
+    if (fPeers) {
+        vector<CNodeStats> vstats;
+        CopyNodeStats(vstats);
+
+        Array peers;
+        BOOST_FOREACH (const CNodeStats& stats, vstats) {
+            Object obj;
+            obj.push_back(Pair("id", stats.nodeid));
+            obj.push_back(Pair("addr", stats.addrName));
+            obj.push_back(Pair("commands", NetMsgStatsToJSON(stats.mapMsgStats)));
+            peers.push_back(obj);
+        }
+        ret.push_back(Pair("peers", peers));
+    }
+    return ret;
+}
+
 static Array GetNetworksInfo()
 {
     Array networks;
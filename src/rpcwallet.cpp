@@ -2556,6 +2556,7 @@ Value resetmintzerocoin(const Array& params, bool fHelp)
     Array arrUpdated;
     for (CZerocoinMint mint : vMintsToUpdate) {
         walletdb.WriteZerocoinMint(mint);
+        pwalletMain->UpdateMintSerial(mint, false);
         arrUpdated.push_back(mint.GetValue().GetHex());
     }
 
@@ -2564,6 +2565,7 @@ Value resetmintzerocoin(const Array& params, bool fHelp)
     for (CZerocoinMint mint : vMintsMissing) {
         arrDeleted.push_back(mint.GetValue().GetHex());
         walletdb.ArchiveMintOrphan(mint);
+        pwalletMain->UpdateMintSerial(mint, true);
     }
 
     Object obj;
@@ -2605,6 +2607,7 @@ Value resetspentzerocoin(const Array& params, bool fHelp)
             if (mint.GetSerialNumber() == spend.GetSerial()) {
                 mint.SetUsed(false);
                 walletdb.WriteZerocoinMint(mint);
+                pwalletMain->UpdateMintSerial(mint, false);
                 walletdb.EraseZerocoinSpendSerialEntry(spend.GetSerial());
                 RemoveSerialFromDB(spend.GetSerial());
                 Object obj;
@@ -2755,6 +2758,7 @@ Value importzerocoins(const Array& params, bool fHelp)
         mint.SetTxHash(txid);
         mint.SetHeight(nHeight);
         walletdb.WriteZerocoinMint(mint);
+        pwalletMain->UpdateMintSerial(mint, false);
         count++;
         nValue += libzerocoin::ZerocoinDenominationToAmount(denom);
     }
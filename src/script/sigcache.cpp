@@ -5,13 +5,13 @@
 
 #include "sigcache.h"
 
+#include "crypto/sha256.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 namespace {
 
@@ -19,56 +19,109 @@ namespace {
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
  * again when accepted into the block chain)
+ *
+ * Entries are salted SHA256 digests of (signature hash, signature, public key),
+ * so each one takes 32 bytes no matter how large the signature is. The table
+ * has a fixed size and is set-associative: a digest can only live in one of
+ * SIGCACHE_WAYS slots of its bucket. Buckets are split over SIGCACHE_SHARDS
+ * independently locked shards so that parallel script checks rarely contend.
  */
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    static const unsigned int SIGCACHE_SHARDS = 16;
+    static const unsigned int SIGCACHE_WAYS = 8;
+
+    struct CShard {
+        std::vector<uint256> vEntries; //! nBuckets * SIGCACHE_WAYS slots, 0 marks an empty slot
+        boost::shared_mutex cs_shard;
+    };
+
+    //! Salt so that peers cannot craft signatures colliding in our buckets
+    uint256 nonce;
+    size_t nBuckets;
+    CShard shards[SIGCACHE_SHARDS];
+
+    void ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size());
+        if (!vchSig.empty())
+            hasher.Write(&vchSig[0], vchSig.size());
+        hasher.Finalize(entry.begin());
+    }
+
+    //! The digest is uniformly distributed, so its low bits pick shard, bucket and the way to evict
+    CShard& ShardFor(const uint256& entry, size_t& nFirstSlot, unsigned int& nVictim)
+    {
+        uint64_t nBits = entry.GetLow64();
+        CShard& shard = shards[nBits % SIGCACHE_SHARDS];
+        nBits /= SIGCACHE_SHARDS;
+        nVictim = nBits % SIGCACHE_WAYS;
+        nBits /= SIGCACHE_WAYS;
+        nFirstSlot = (nBits % nBuckets) * SIGCACHE_WAYS;
+        return shard;
+    }
 
 public:
+    CSignatureCache() : nonce(GetRandHash()), nBuckets(0)
+    {
+        int64_t nMaxCacheSize = std::min(std::max(GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE), (int64_t)0), MAX_MAX_SIG_CACHE_SIZE);
+        size_t nEntries = (size_t)nMaxCacheSize * 1024 * 1024 / sizeof(uint256);
+        nBuckets = nEntries / (SIGCACHE_SHARDS * SIGCACHE_WAYS);
+        for (unsigned int i = 0; i < SIGCACHE_SHARDS; i++)
+            shards[i].vEntries.resize(nBuckets * SIGCACHE_WAYS);
+        LogPrintf("Using %u MiB for signature cache, able to store %u elements\n",
+            (unsigned int)nMaxCacheSize, (unsigned int)(nBuckets * SIGCACHE_SHARDS * SIGCACHE_WAYS));
+    }
+
     bool
     Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        if (nBuckets == 0)
+            return false;
+
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
+        size_t nFirstSlot;
+        unsigned int nVictim;
+        CShard& shard = ShardFor(entry, nFirstSlot, nVictim);
+
+        boost::shared_lock<boost::shared_mutex> lock(shard.cs_shard);
+        for (unsigned int i = 0; i < SIGCACHE_WAYS; i++) {
+            if (shard.vEntries[nFirstSlot + i] == entry)
+                return true;
+        }
         return false;
     }
 
     void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
-        {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
+        if (nBuckets == 0)
+            return;
+
+        uint256 entry;
+        ComputeEntry(entry, hash, vchSig, pubKey);
+
+        size_t nFirstSlot;
+        unsigned int nVictim;
+        CShard& shard = ShardFor(entry, nFirstSlot, nVictim);
+
+        boost::unique_lock<boost::shared_mutex> lock(shard.cs_shard);
+        // Use a free slot of the bucket if there is one. Otherwise overwrite the way
+        // selected by the salted digest, which an attacker cannot predict.
+        unsigned int nSlot = nVictim;
+        for (unsigned int i = 0; i < SIGCACHE_WAYS; i++) {
+            const uint256& slot = shard.vEntries[nFirstSlot + i];
+            if (slot == entry)
+                return;
+            if (slot == 0) {
+                nSlot = i;
+                break;
+            }
         }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        shard.vEntries[nFirstSlot + nSlot] = entry;
     }
 };
 
@@ -10,6 +10,11 @@
 
 #include <vector>
 
+/** Default for -maxsigcachesize, in MiB (32 bytes per entry, about a million signatures) */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Maximum signature cache size allowed, in MiB */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 1024;
+
 class CPubKey;
 
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
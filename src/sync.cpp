@@ -7,6 +7,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
 #include <stdio.h>
 
 #include <boost/foreach.hpp>
@@ -20,6 +21,85 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+// Set once during init while worker threads may already be taking locks
+static std::atomic<void*> pLockWaitWatched(NULL);
+static thread_local int64_t nThreadLockWait = 0;
+
+void WatchLockWait(void* cs)
+{
+    pLockWaitWatched = cs;
+}
+
+bool IsLockWaitWatched(void* cs)
+{
+    return cs == pLockWaitWatched;
+}
+
+void AddThreadLockWait(int64_t nMicros)
+{
+    nThreadLockWait += nMicros;
+}
+
+int64_t GetThreadLockWait()
+{
+    return nThreadLockWait;
+}
+
+#ifdef DEBUG_LOCKPROFILE
+// Function statics, lock sites can be hit during static initialization of other modules
+static boost::mutex& LockSitesMutex()
+{
+    static boost::mutex mutex;
+    return mutex;
+}
+
+static std::vector<CLockSite*>& LockSites()
+{
+    static std::vector<CLockSite*> vSites;
+    return vSites;
+}
+
+CLockSite::CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn) : pszName(pszNameIn), pszFile(pszFileIn), nLine(nLineIn),
+                                                                                nAcquired(0), nContended(0), nTryFailed(0), nWaitTime(0), nHoldTime(0)
+{
+    boost::lock_guard<boost::mutex> lock(LockSitesMutex());
+    LockSites().push_back(this);
+}
+
+void GetLockStats(std::vector<CLockSiteStats>& vStats)
+{
+    // A site in a template function has one instance per instantiation, merge them
+    std::map<std::pair<std::string, int>, CLockSiteStats> mapStats;
+    {
+        boost::lock_guard<boost::mutex> lock(LockSitesMutex());
+        BOOST_FOREACH (const CLockSite* psite, LockSites()) {
+            std::pair<std::string, int> key(psite->pszFile, psite->nLine);
+            std::map<std::pair<std::string, int>, CLockSiteStats>::iterator it = mapStats.find(key);
+            if (it == mapStats.end()) {
+                CLockSiteStats stats;
+                stats.strName = psite->pszName;
+                stats.strFile = psite->pszFile;
+                stats.nLine = psite->nLine;
+                stats.nAcquired = stats.nContended = stats.nTryFailed = 0;
+                stats.nWaitTime = stats.nHoldTime = 0;
+                it = mapStats.insert(std::make_pair(key, stats)).first;
+            }
+            CLockSiteStats& stats = it->second;
+            stats.nAcquired += psite->nAcquired.load(std::memory_order_relaxed);
+            stats.nContended += psite->nContended.load(std::memory_order_relaxed);
+            stats.nTryFailed += psite->nTryFailed.load(std::memory_order_relaxed);
+            stats.nWaitTime += psite->nWaitTime.load(std::memory_order_relaxed);
+            stats.nHoldTime += psite->nHoldTime.load(std::memory_order_relaxed);
+        }
+    }
+
+    vStats.clear();
+    vStats.reserve(mapStats.size());
+    for (std::map<std::pair<std::string, int>, CLockSiteStats>::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it)
+        vStats.push_back(it->second);
+}
+#endif /* DEBUG_LOCKPROFILE */
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
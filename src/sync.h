@@ -7,12 +7,19 @@
 #define BITCOIN_SYNC_H
 
 #include "threadsafety.h"
+#include "utiltime.h"
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#ifdef DEBUG_LOCKPROFILE
+#include <atomic>
+#include <string>
+#include <vector>
+#endif
+
 
 ////////////////////////////////////////////////
 //                                            //
@@ -104,23 +111,92 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Wait accounting for one critical section (cs_main, for the network profiler): a
+ * contended LOCK() on the critical section passed to WatchLockWait() adds the time it
+ * blocked to a counter of the calling thread, read with GetThreadLockWait().
+ */
+void WatchLockWait(void* cs);
+bool IsLockWaitWatched(void* cs);
+void AddThreadLockWait(int64_t nMicros);
+int64_t GetThreadLockWait();
+
+#ifdef DEBUG_LOCKPROFILE
+/**
+ * Counters of one LOCK()/LOCK2()/TRY_LOCK() site, compiled in with DEBUG_LOCKPROFILE
+ * (configure --enable-lockprofile). Each site owns a static instance that registers
+ * itself on first use; getlockstats reports them. Times are in microseconds.
+ */
+class CLockSite
+{
+public:
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended; // acquisitions that had to wait
+    std::atomic<uint64_t> nTryFailed; // TRY_LOCK that did not get the lock
+    std::atomic<int64_t> nWaitTime;
+    std::atomic<int64_t> nHoldTime;
+
+    CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn);
+};
+
+/** Snapshot of the counters of a lock site */
+struct CLockSiteStats {
+    std::string strName;
+    std::string strFile;
+    int nLine;
+    uint64_t nAcquired;
+    uint64_t nContended;
+    uint64_t nTryFailed;
+    int64_t nWaitTime;
+    int64_t nHoldTime;
+};
+
+void GetLockStats(std::vector<CLockSiteStats>& vStats);
+
+#define LOCK_SITE(cs) , []() { static CLockSite site(#cs, __FILE__, __LINE__); return &site; }()
+#else
+#define LOCK_SITE(cs)
+#endif
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+#ifdef DEBUG_LOCKPROFILE
+    CLockSite* psite;
+    int64_t nLockedSince;
+
+    void Acquired()
+    {
+        psite->nAcquired.fetch_add(1, std::memory_order_relaxed);
+        nLockedSince = GetTimeMicros();
+    }
+#endif
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t nStart = GetTimeMicros();
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            int64_t nWait = GetTimeMicros() - nStart;
+            if (IsLockWaitWatched((void*)(lock.mutex())))
+                AddThreadLockWait(nWait);
+#ifdef DEBUG_LOCKPROFILE
+            psite->nContended.fetch_add(1, std::memory_order_relaxed);
+            psite->nWaitTime.fetch_add(nWait, std::memory_order_relaxed);
+#endif
         }
+#ifdef DEBUG_LOCKPROFILE
+        Acquired();
 #endif
     }
 
@@ -130,11 +206,21 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+#ifdef DEBUG_LOCKPROFILE
+        if (lock.owns_lock())
+            Acquired();
+        else
+            psite->nTryFailed.fetch_add(1, std::memory_order_relaxed);
+#endif
         return lock.owns_lock();
     }
 
 public:
+#ifdef DEBUG_LOCKPROFILE
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry, CLockSite* psiteIn) : lock(mutexIn, boost::defer_lock), psite(psiteIn), nLockedSince(0)
+#else
     CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock)
+#endif
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -144,8 +230,12 @@ public:
 
     ~CMutexLock()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+#ifdef DEBUG_LOCKPROFILE
+            psite->nHoldTime.fetch_add(GetTimeMicros() - nLockedSince, std::memory_order_relaxed);
+#endif
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -156,9 +246,9 @@ public:
 
 typedef CMutexLock<CCriticalSection> CCriticalBlock;
 
-#define LOCK(cs) CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__)
-#define LOCK2(cs1, cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__), criticalblock2(cs2, #cs2, __FILE__, __LINE__)
-#define TRY_LOCK(cs, name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true)
+#define LOCK(cs) CCriticalBlock criticalblock(cs, #cs, __FILE__, __LINE__, false LOCK_SITE(cs))
+#define LOCK2(cs1, cs2) CCriticalBlock criticalblock1(cs1, #cs1, __FILE__, __LINE__, false LOCK_SITE(cs1)), criticalblock2(cs2, #cs2, __FILE__, __LINE__, false LOCK_SITE(cs2))
+#define TRY_LOCK(cs, name) CCriticalBlock name(cs, #cs, __FILE__, __LINE__, true LOCK_SITE(cs))
 
 #define ENTER_CRITICAL_SECTION(cs)                            \
     {                                                         \
@@ -369,6 +369,131 @@ Testb_MintAndSpend()
 	return false;
 }
 
+bool
+Testb_SoKFixedBaseEquivalence()
+{
+	try {
+		// This test assumes a list of coins were generated in Testb_MintCoin()
+		if (ggCoins[0] == NULL) {
+			return false;
+		}
+
+		// Same parameters without the precomputed fixed-base tables
+		ZerocoinParams plainParams = *gg_Params;
+		plainParams.coinCommitmentGroup.fixedBase.reset();
+		plainParams.serialNumberSoKCommitmentGroup.fixedBase.reset();
+
+		// The fixed-base path must agree with plain modular exponentiation
+		const IntegerGroupParams& group = gg_Params->serialNumberSoKCommitmentGroup;
+		CBigNum a = CBigNum::randBignum(group.groupOrder);
+		CBigNum b = CBigNum::randBignum(group.groupOrder);
+		if (group.ghPow(a, b) != plainParams.serialNumberSoKCommitmentGroup.ghPow(a, b)) {
+			cout << "Fixed-base exponentiation does not match pow_mod" << endl;
+			return false;
+		}
+
+		Accumulator acc(&gg_Params->accumulatorParams, CoinDenomination::ZQ_ONE);
+		AccumulatorWitness wAcc(gg_Params, acc, ggCoins[0]->getPublicCoin());
+		for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE; i++) {
+			acc += ggCoins[i]->getPublicCoin();
+			wAcc += ggCoins[i]->getPublicCoin();
+		}
+
+		CoinSpend spend(gg_Params, *(ggCoins[0]), acc, 0, wAcc, 0);
+		CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+		ss << spend;
+		CDataStream ssPlain(ss);
+		CoinSpend fixedSpend(gg_Params, ss);
+		CoinSpend plainSpend(&plainParams, ssPlain);
+
+		timer.start();
+		bool fPlain = plainSpend.Verify(acc);
+		timer.stop();
+		cout << "\tSPEND VERIFY (pow_mod) ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+
+		timer.start();
+		bool fFixed = fixedSpend.Verify(acc);
+		timer.stop();
+		cout << "\tSPEND VERIFY (fixed-base) ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << endl;
+
+		return fPlain && fFixed;
+	} catch (runtime_error &e) {
+		cout << e.what() << endl;
+		return false;
+	}
+}
+
+#define TESTS_BIGNUM_ITERATIONS     200
+
+// pow_mod as it was done before BN_CTX pooling and cached Montgomery contexts
+CBigNum
+gPowModFreshContext(const CBigNum& base, const CBigNum& e, const CBigNum& m)
+{
+	BN_CTX* pctx = BN_CTX_new();
+	CBigNum ret;
+	BN_mod_exp(&ret, &base, &e, &m, pctx);
+	BN_CTX_free(pctx);
+	return ret;
+}
+
+bool
+Testb_BigNumContextsEquivalence()
+{
+	try {
+		// This test assumes a list of coins were generated in Testb_MintCoin()
+		if (ggCoins[0] == NULL) {
+			return false;
+		}
+
+		// Accumulator increment: value = value^coin mod N
+		const CBigNum& accModulus = gg_Params->accumulatorParams.accumulatorModulus;
+		CBigNum valueFresh = gg_Params->accumulatorParams.accumulatorBase;
+		timer.start();
+		for (uint32_t i = 0; i < TESTS_BIGNUM_ITERATIONS; i++) {
+			valueFresh = gPowModFreshContext(valueFresh, ggCoins[i % TESTS_COINS_TO_ACCUMULATE]->getPublicCoin().getValue(), accModulus);
+		}
+		timer.stop();
+		cout << "\tACCUMULATOR INCREMENT (fresh BN_CTX): " << timer.duration() << " ms for " << TESTS_BIGNUM_ITERATIONS << " increments" << endl;
+
+		Accumulator acc(&gg_Params->accumulatorParams, CoinDenomination::ZQ_ONE);
+		timer.start();
+		for (uint32_t i = 0; i < TESTS_BIGNUM_ITERATIONS; i++) {
+			acc.increment(ggCoins[i % TESTS_COINS_TO_ACCUMULATE]->getPublicCoin().getValue());
+		}
+		timer.stop();
+		cout << "\tACCUMULATOR INCREMENT (pooled BN_CTX, cached Montgomery): " << timer.duration() << " ms for " << TESTS_BIGNUM_ITERATIONS << " increments" << endl;
+
+		if (acc.getValue() != valueFresh) {
+			cout << "Accumulator values don't match" << endl;
+			return false;
+		}
+
+		// The exponentiation by a proof-supplied base in SerialNumberSignatureOfKnowledge::Verify
+		const IntegerGroupParams& group = gg_Params->serialNumberSoKCommitmentGroup;
+		CBigNum base = group.randomElement();
+		CBigNum e = CBigNum::randBignum(group.groupOrder);
+		CBigNum rFresh, rCached;
+		timer.start();
+		for (uint32_t i = 0; i < TESTS_BIGNUM_ITERATIONS; i++) {
+			rFresh = gPowModFreshContext(base, e, group.modulus);
+		}
+		timer.stop();
+		cout << "\tSOK VERIFY POW_MOD (fresh BN_CTX): " << timer.duration() << " ms for " << TESTS_BIGNUM_ITERATIONS << " exponentiations" << endl;
+
+		timer.start();
+		for (uint32_t i = 0; i < TESTS_BIGNUM_ITERATIONS; i++) {
+			rCached = base.pow_mod(e, group.modulus);
+		}
+		timer.stop();
+		cout << "\tSOK VERIFY POW_MOD (pooled BN_CTX, cached Montgomery): " << timer.duration() << " ms for " << TESTS_BIGNUM_ITERATIONS << " exponentiations" << endl;
+
+		return rFresh == rCached;
+	} catch (runtime_error &e) {
+		cout << e.what() << endl;
+		return false;
+	}
+}
+
 void
 Testb_RunAllTests()
 {
@@ -388,6 +513,8 @@ Testb_RunAllTests()
 	gLogTestResult("coins can be minted", Testb_MintCoin);
 	gLogTestResult("the accumulator works", Testb_Accumulator);
 	gLogTestResult("a minted coin can be spent", Testb_MintAndSpend);
+	gLogTestResult("fixed-base tables give the same spend verification as pow_mod", Testb_SoKFixedBaseEquivalence);
+	gLogTestResult("pooled contexts give the same modular exponentiation as fresh ones", Testb_BigNumContextsEquivalence);
 
 	// Summarize test results
 	if (ggSuccessfulTests < ggNumTests) {
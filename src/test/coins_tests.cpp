@@ -175,4 +175,74 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+// Check that the memory usage reported by a cache follows the entries that are
+// added, modified and spent, and drops back to that of an empty cache on Flush.
+BOOST_AUTO_TEST_CASE(coins_cache_memory_usage_test)
+{
+    CCoinsViewTest base;
+    CCoinsViewCache cache(&base);
+    const size_t nBaseline = cache.DynamicMemoryUsage();
+
+    std::vector<uint256> txids;
+    for (unsigned int i = 0; i < 100; i++) {
+        txids.push_back(GetRandHash());
+        CCoinsModifier entry = cache.ModifyCoins(txids.back());
+        entry->nVersion = 1;
+        entry->vout.resize(2);
+        for (unsigned int n = 0; n < entry->vout.size(); n++) {
+            entry->vout[n].nValue = insecure_rand();
+            entry->vout[n].scriptPubKey = CScript() << std::vector<unsigned char>(40, i);
+        }
+    }
+    size_t nUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage > nBaseline);
+
+    // Growing an entry in place only adds the growth of its outputs
+    {
+        const size_t nOld = cache.AccessCoins(txids[0])->DynamicMemoryUsage();
+        {
+            CCoinsModifier entry = cache.ModifyCoins(txids[0]);
+            entry->vout.resize(8);
+            entry->vout[7].nValue = 1;
+            entry->vout[7].scriptPubKey = CScript() << std::vector<unsigned char>(100, 1);
+        }
+        const size_t nNew = cache.AccessCoins(txids[0])->DynamicMemoryUsage();
+        BOOST_CHECK(nNew > nOld);
+        BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage - nOld + nNew);
+        nUsage = cache.DynamicMemoryUsage();
+    }
+
+    // Spending a fresh entry removes it and its outputs
+    {
+        const size_t nOld = cache.AccessCoins(txids[1])->DynamicMemoryUsage();
+        {
+            CCoinsModifier entry = cache.ModifyCoins(txids[1]);
+            entry->Spend(0);
+            entry->Spend(1);
+        }
+        BOOST_CHECK(cache.AccessCoins(txids[1]) == NULL);
+        BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage - nOld);
+    }
+
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nBaseline);
+
+    // Entries fetched from the parent are counted, and spending one releases its outputs
+    {
+        const size_t nOld = cache.AccessCoins(txids[2])->DynamicMemoryUsage();
+        nUsage = cache.DynamicMemoryUsage();
+        BOOST_CHECK(nUsage > nBaseline);
+        {
+            CCoinsModifier entry = cache.ModifyCoins(txids[2]);
+            entry->Spend(0);
+            entry->Spend(1);
+        }
+        BOOST_CHECK(cache.AccessCoins(txids[2])->IsPruned());
+        BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage - nOld);
+    }
+
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nBaseline);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
 #include "utilstrencodings.h"
 
 #include <vector>
@@ -46,4 +47,24 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(xevan_header_batch)
+{
+    // mix XEVAN (v3) and double SHA-256 (v4) headers
+    vector<CBlockHeader> vHeaders(300);
+    for (unsigned int i = 0; i < vHeaders.size(); i++) {
+        vHeaders[i].nVersion = i % 3 ? 3 : 4;
+        vHeaders[i].nTime = 1500000000 + i;
+        vHeaders[i].nNonce = i * 7919;
+    }
+
+    // the second batch runs on the workers left over from the first
+    for (int nThreads = 4; nThreads >= 2; nThreads -= 2) {
+        vector<uint256> vHashes;
+        GetBlockHeaderHashes(vHeaders, vHashes, nThreads);
+        BOOST_CHECK_EQUAL(vHashes.size(), vHeaders.size());
+        for (unsigned int i = 0; i < vHeaders.size(); i++)
+            BOOST_CHECK(vHashes[i] == vHeaders[i].GetHash());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
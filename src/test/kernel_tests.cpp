@@ -0,0 +1,89 @@
+// Copyright (c) 2018 The BitMoney developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+#include "random.h"
+
+#include <boost/foreach.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+BOOST_AUTO_TEST_CASE(stake_hash_prefix)
+{
+    // The kernel search hashes from a precomputed prefix; it must match the serialized stake hash
+    for (int i = 0; i < 100; i++) {
+        CStakeKernelCandidate candidate;
+        candidate.prevout = COutPoint(GetRandHash(), insecure_rand() % 16);
+        candidate.nValue = insecure_rand();
+        candidate.nTimeBlockFrom = insecure_rand();
+        candidate.nStakeModifier = ((uint64_t)insecure_rand() << 32) | insecure_rand();
+        candidate.InitHasher();
+
+        CDataStream ss(SER_GETHASH, 0);
+        ss << candidate.nStakeModifier;
+        unsigned int nTimeTx = candidate.nTimeBlockFrom + insecure_rand() % 100000;
+        BOOST_CHECK(stakeHash(candidate, nTimeTx) == stakeHash(nTimeTx, ss, candidate.prevout.n, candidate.prevout.hash, candidate.nTimeBlockFrom));
+    }
+}
+
+// Append nBlocks to pindexPrev, one minute apart, each generating the stake modifier
+// nModifierBase + height. Every block becomes the tip in turn, as in UpdateTip.
+static void ExtendKernelTestChain(CBlockIndex* pindexPrev, int nBlocks, uint64_t nModifierBase, std::vector<CBlockIndex*>& vBlocks)
+{
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndex* pindex = new CBlockIndex();
+        pindex->pprev = pindexPrev;
+        pindex->nHeight = pindexPrev->nHeight + 1;
+        pindex->nTime = pindexPrev->nTime + 60;
+        pindex->SetStakeModifier(nModifierBase + pindex->nHeight, true);
+        vBlocks.push_back(pindex);
+        chainActive.SetTip(pindex);
+        UpdateKernelStakeModifiers();
+        pindexPrev = pindex;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_modifier_cache_reorg)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexStart = chainActive.Tip();
+    std::vector<CBlockIndex*> vBlocks;
+
+    ExtendKernelTestChain(pindexStart, 200, 1000, vBlocks);
+    CBlockIndex* pindexTipA = chainActive.Tip();
+    const CBlockIndex* pindexFrom = chainActive[pindexStart->nHeight + 10];
+
+    uint64_t nModifier;
+    int nModifierHeight;
+    int64_t nModifierTime;
+    BOOST_CHECK(GetKernelStakeModifier(pindexFrom, nModifier, nModifierHeight, nModifierTime, false));
+    BOOST_CHECK(nModifierHeight > pindexFrom->nHeight);
+    BOOST_CHECK_EQUAL(nModifier, (uint64_t)(1000 + nModifierHeight));
+    const int nModifierHeightA = nModifierHeight;
+
+    // The tip itself has no block a selection interval later yet
+    BOOST_CHECK(!GetKernelStakeModifier(pindexTipA, nModifier, nModifierHeight, nModifierTime, false));
+
+    // Reorg to a longer branch forking right after pindexFrom, the cached entry must not survive it
+    ExtendKernelTestChain(const_cast<CBlockIndex*>(pindexFrom), 250, 2000, vBlocks);
+    BOOST_CHECK(GetKernelStakeModifier(pindexFrom, nModifier, nModifierHeight, nModifierTime, false));
+    BOOST_CHECK_EQUAL(nModifierHeight, nModifierHeightA);
+    BOOST_CHECK_EQUAL(nModifier, (uint64_t)(2000 + nModifierHeight));
+
+    // And back to the first branch
+    chainActive.SetTip(pindexTipA);
+    UpdateKernelStakeModifiers();
+    BOOST_CHECK(GetKernelStakeModifier(pindexFrom, nModifier, nModifierHeight, nModifierTime, false));
+    BOOST_CHECK_EQUAL(nModifier, (uint64_t)(1000 + nModifierHeight));
+
+    // Leave the cache without entries that point into the test blocks
+    chainActive.SetTip(pindexStart);
+    UpdateKernelStakeModifiers();
+    BOOST_FOREACH (CBlockIndex* pindex, vBlocks)
+        delete pindex;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
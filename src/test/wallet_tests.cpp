@@ -4,6 +4,9 @@
 
 #include "wallet.h"
 
+#include "main.h"
+#include "script/standard.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -21,6 +24,8 @@
 
 using namespace std;
 
+extern CWallet* pwalletMain;
+
 typedef set<pair<const CWalletTx*,unsigned int> > CoinSet;
 
 BOOST_AUTO_TEST_SUITE(wallet_tests)
@@ -305,4 +310,96 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+// Append a block holding only tx to the active chain and hand tx to the wallet as
+// ConnectTip does. Requires cs_main.
+static CBlockIndex* ConnectWalletTestBlock(const CTransaction& tx)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.nTime = chainActive.Tip()->nTime + 1;
+    block.vtx.push_back(tx);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockIndex* pindex = new CBlockIndex(block);
+    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(block.GetHash(), pindex)).first;
+    pindex->phashBlock = &mi->first;
+    pindex->pprev = chainActive.Tip();
+    pindex->nHeight = pindex->pprev->nHeight + 1;
+    chainActive.SetTip(pindex);
+
+    pwalletMain->SyncTransaction(tx, &block);
+    return pindex;
+}
+
+static CTransaction SpendWalletTestOutput(const uint256& hash, unsigned int n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(hash, n);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1 * COIN;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(wallet_unspent_tracking)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->AddKeyPubKey(key, key.GetPubKey()));
+    }
+
+    LOCK(cs_main);
+    CBlockIndex* pindexStart = chainActive.Tip();
+
+    CMutableTransaction txFund;
+    txFund.vin.resize(1);
+    txFund.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txFund.vout.resize(2);
+    txFund.vout[0].nValue = 7 * COIN;
+    txFund.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    txFund.vout[1].nValue = 3 * COIN;
+    txFund.vout[1].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    const CTransaction txFunding(txFund);
+    const uint256 hashFund = txFunding.GetHash();
+    const CTransaction txSpend0 = SpendWalletTestOutput(hashFund, 0);
+    const CTransaction txSpend1 = SpendWalletTestOutput(hashFund, 1);
+
+    // Receiving outputs of ours adds the transaction
+    vector<CBlockIndex*> vBlocks;
+    vBlocks.push_back(ConnectWalletTestBlock(txFunding));
+    BOOST_CHECK(pwalletMain->mapWalletUnspent.count(hashFund));
+
+    // It stays while one output is unspent, the spend itself pays nothing to us
+    vBlocks.push_back(ConnectWalletTestBlock(txSpend0));
+    BOOST_CHECK(pwalletMain->mapWalletUnspent.count(hashFund));
+    BOOST_CHECK(!pwalletMain->mapWalletUnspent.count(txSpend0.GetHash()));
+
+    // Spending the last output drops it
+    vBlocks.push_back(ConnectWalletTestBlock(txSpend1));
+    BOOST_CHECK(!pwalletMain->mapWalletUnspent.count(hashFund));
+
+    // Disconnecting the last spend brings it back, as DisconnectTip syncs the transaction without a block
+    chainActive.SetTip(vBlocks[1]);
+    pwalletMain->SyncTransaction(txSpend1, NULL);
+    BOOST_CHECK(pwalletMain->mapWalletUnspent.count(hashFund));
+
+    // Once the spend is back in the chain, MarkDirty leaves the spent transaction out again
+    chainActive.SetTip(vBlocks[2]);
+    pwalletMain->MarkDirty();
+    BOOST_CHECK(!pwalletMain->mapWalletUnspent.count(hashFund));
+
+    chainActive.SetTip(pindexStart);
+    pwalletMain->EraseFromWallet(txSpend1.GetHash());
+    pwalletMain->EraseFromWallet(txSpend0.GetHash());
+    pwalletMain->EraseFromWallet(hashFund);
+    BOOST_FOREACH (CBlockIndex* pindex, vBlocks) {
+        const uint256 hash = pindex->GetBlockHash();
+        mapBlockIndex.erase(hash);
+        delete pindex;
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -208,85 +208,162 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+bool CBlockTreeDB::WriteMoneySupplyProgress(const std::vector<const CBlockIndex*>& vIndexes, int nHeight)
 {
-    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CLevelDBBatch batch;
+    for (std::vector<const CBlockIndex*>::const_iterator it = vIndexes.begin(); it != vIndexes.end(); it++)
+        batch.Write(make_pair('b', (*it)->GetBlockHash()), CDiskBlockIndex(const_cast<CBlockIndex*>(*it)));
+    if (nHeight > 0)
+        batch.Write(std::make_pair('I', std::string("moneysupplyheight")), nHeight);
+    else
+        batch.Erase(std::make_pair('I', std::string("moneysupplyheight")));
+    return WriteBatch(batch);
+}
 
-    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
-    ssKeySet << make_pair('b', uint256(0));
-    pcursor->Seek(ssKeySet.str());
+bool CBlockTreeDB::ReadMoneySupplyProgress(int& nHeight)
+{
+    return ReadInt("moneysupplyheight", nHeight);
+}
 
-    // Load mapBlockIndex
-    uint256 nPreviousCheckpoint;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        try {
+/** Block index entries of one range of the 'b' key space, decoded and hash checked by a worker thread */
+struct CBlockIndexRange {
+    int nFirst;
+    int nEnd;
+    std::vector<std::pair<uint256, CDiskBlockIndex> > vEntries;
+    bool fOk;
+
+    CBlockIndexRange(int nFirstIn, int nEndIn) : nFirst(nFirstIn), nEnd(nEndIn), fOk(true) {}
+};
+
+/**
+ * Keys are ('b', hash) and the first serialized byte of the hash is spread evenly, so the key space
+ * is split on that byte. Computing the header hash (XEVAN for pre zerocoin headers) and checking the
+ * proof of work dominate loading the index and need no shared state.
+ */
+static void LoadBlockIndexRange(CBlockTreeDB* pdb, CBlockIndexRange* prange)
+{
+    try {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(pdb->NewIterator());
+
+        uint256 hashSeek = 0;
+        *hashSeek.begin() = (unsigned char)prange->nFirst;
+        CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+        ssKeySet << make_pair('b', hashSeek);
+        pcursor->Seek(ssKeySet.str());
+
+        while (pcursor->Valid()) {
             leveldb::Slice slKey = pcursor->key();
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
             ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
-                pindexNew->mapZerocoinSupply = diskindex.mapZerocoinSupply;
-                pindexNew->vMintDenominationsInBlock = diskindex.vMintDenominationsInBlock;
-
-                //Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+            if (chType != 'b')
+                break;
+
+            uint256 hashKey;
+            ssKey >> hashKey;
+            if (*hashKey.begin() >= prange->nEnd)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CDiskBlockIndex diskindex;
+            ssValue >> diskindex;
+
+            uint256 hashBlock = diskindex.GetBlockHash();
+            if (diskindex.nHeight <= Params().LAST_POW_BLOCK()) {
+                if (!CheckProofOfWork(hashBlock, diskindex.nBits)) {
+                    prange->fOk = error("LoadBlockIndex() : CheckProofOfWork failed: %s", diskindex.ToString());
+                    return;
                 }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+            }
+
+            prange->vEntries.push_back(make_pair(hashBlock, diskindex));
+            pcursor->Next();
+        }
+    } catch (std::exception& e) {
+        prange->fOk = error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+}
 
-                //populate accumulator checksum map in memory
-                if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
-                    //Don't load any invalid checkpoints
-                    if (!InvalidCheckpointRange(pindexNew->nHeight))
-                        LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
+bool CBlockTreeDB::LoadBlockIndexGuts()
+{
+    int64_t nTimeStart = GetTimeMillis();
 
-                    nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
-                }
+    // Decode and hash check the block index on a worker per key range
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), 16));
+    std::vector<CBlockIndexRange> vRanges;
+    for (int i = 0; i < nThreads; i++)
+        vRanges.push_back(CBlockIndexRange(i * 256 / nThreads, (i + 1) * 256 / nThreads));
+
+    boost::thread_group threadGroup;
+    for (CBlockIndexRange& range : vRanges)
+        threadGroup.create_thread(boost::bind(&LoadBlockIndexRange, this, &range));
+    threadGroup.join_all();
 
-                pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
+    size_t nEntries = 0;
+    for (const CBlockIndexRange& range : vRanges) {
+        if (!range.fOk)
+            return false;
+        nEntries += range.vEntries.size();
+    }
+
+    int64_t nTimeDecoded = GetTimeMillis();
+    LogPrintf("%s : decoded %u block index entries in %dms using %d threads\n", __func__, nEntries, nTimeDecoded - nTimeStart, nThreads);
+
+    // Load mapBlockIndex
+    uint256 nPreviousCheckpoint;
+    for (const CBlockIndexRange& range : vRanges) {
+        for (const std::pair<uint256, CDiskBlockIndex>& entry : range.vEntries) {
+            boost::this_thread::interruption_point();
+            const CDiskBlockIndex& diskindex = entry.second;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(entry.first);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //zerocoin
+            pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
+            pindexNew->mapZerocoinSupply = diskindex.mapZerocoinSupply;
+            pindexNew->vMintDenominationsInBlock = diskindex.vMintDenominationsInBlock;
+
+            //Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            pindexNew->prevoutStake = diskindex.prevoutStake;
+            pindexNew->nStakeTime = diskindex.nStakeTime;
+            pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
+
+            // ppcoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+
+            //populate accumulator checksum map in memory
+            if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
+                //Don't load any invalid checkpoints
+                if (!InvalidCheckpointRange(pindexNew->nHeight))
+                    LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
+
+                nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
             }
-        } catch (std::exception& e) {
-            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
 
+    LogPrintf("%s : linked block index in %dms\n", __func__, GetTimeMillis() - nTimeDecoded);
+
     return true;
 }
 
@@ -365,3 +442,50 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('a', nChecksum));
 }
+
+/**
+ * Pubcoins minted in a block, grouped by denomination under ('p', (height, denom)).
+ * The (height, ZQ_ERROR) entry records the hash of the indexed block so that readers
+ * can tell an indexed block without mints from a block that has not been indexed yet.
+ */
+bool CZerocoinDB::WriteBlockPubcoins(const CBlockIndex* pindex, const std::list<CZerocoinMint>& listMints)
+{
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+    for (const CZerocoinMint& mint : listMints)
+        mapPubcoins[mint.GetDenomination()].emplace_back(mint.GetValue());
+
+    CLevelDBBatch batch;
+    for (auto denom : zerocoinDenomList) {
+        if (mapPubcoins.count(denom))
+            batch.Write(make_pair('p', make_pair(pindex->nHeight, (int)denom)), mapPubcoins.at(denom));
+        else
+            batch.Erase(make_pair('p', make_pair(pindex->nHeight, (int)denom)));
+    }
+    batch.Write(make_pair('p', make_pair(pindex->nHeight, (int)ZQ_ERROR)), pindex->GetBlockHash());
+
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadBlockPubcoins(const CBlockIndex* pindex, CoinDenomination denom, std::vector<CBigNum>& vValues)
+{
+    vValues.clear();
+
+    uint256 hashBlock;
+    if (!Read(make_pair('p', make_pair(pindex->nHeight, (int)ZQ_ERROR)), hashBlock) || hashBlock != pindex->GetBlockHash())
+        return false;
+
+    if (!Exists(make_pair('p', make_pair(pindex->nHeight, (int)denom))))
+        return true;
+
+    return Read(make_pair('p', make_pair(pindex->nHeight, (int)denom)), vValues);
+}
+
+bool CZerocoinDB::EraseBlockPubcoins(const CBlockIndex* pindex)
+{
+    CLevelDBBatch batch;
+    for (auto denom : zerocoinDenomList)
+        batch.Erase(make_pair('p', make_pair(pindex->nHeight, (int)denom)));
+    batch.Erase(make_pair('p', make_pair(pindex->nHeight, (int)ZQ_ERROR)));
+
+    return WriteBatch(batch);
+}
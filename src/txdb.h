@@ -13,6 +13,7 @@
 #include "main.h"
 #include "primitives/zerocoin.h"
 
+#include <list>
 #include <map>
 #include <string>
 #include <utility>
@@ -68,6 +69,9 @@ public:
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
+    //! Rewrite block index entries and record the last recalculated height in one batch, 0 clears it
+    bool WriteMoneySupplyProgress(const std::vector<const CBlockIndex*>& vIndexes, int nHeight);
+    bool ReadMoneySupplyProgress(int& nHeight);
     bool LoadBlockIndexGuts();
 };
 
@@ -90,6 +94,9 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    bool WriteBlockPubcoins(const CBlockIndex* pindex, const std::list<CZerocoinMint>& listMints);
+    bool ReadBlockPubcoins(const CBlockIndex* pindex, libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
+    bool EraseBlockPubcoins(const CBlockIndex* pindex);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -439,6 +439,45 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+/** Outpoint is spent by a wallet transaction in the active chain, which only a reorg can undo */
+bool CWallet::IsSpentInMainChain(const uint256& hash, unsigned int n) const
+{
+    const COutPoint outpoint(hash, n);
+    pair<TxSpends::const_iterator, TxSpends::const_iterator> range;
+    range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) >= 1)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::AddToWalletUnspent(const CWalletTx& wtx)
+{
+    BOOST_FOREACH (const CTxOut& txout, wtx.vout) {
+        if (IsMine(txout) != ISMINE_NO) {
+            mapWalletUnspent[wtx.GetHash()] = &wtx;
+            return;
+        }
+    }
+}
+
+// requires LOCK2(cs_main, cs_wallet)
+void CWallet::UpdateWalletUnspent(const uint256& hash)
+{
+    std::map<uint256, const CWalletTx*>::iterator it = mapWalletUnspent.find(hash);
+    if (it == mapWalletUnspent.end())
+        return;
+
+    const CWalletTx& wtx = *it->second;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpentInMainChain(hash, i))
+            return;
+    }
+    mapWalletUnspent.erase(it);
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
@@ -650,9 +689,13 @@ CWallet::TxItems CWallet::OrderedTxItems(std::list<CAccountingEntry>& acentries,
 void CWallet::MarkDirty()
 {
     {
-        LOCK(cs_wallet);
-        BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
+        LOCK2(cs_main, cs_wallet);
+        BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet) {
             item.second.MarkDirty();
+            // Outputs may have become ours (key or watch-only import), the spent ones drop out again
+            AddToWalletUnspent(item.second);
+            UpdateWalletUnspent(item.first);
+        }
     }
 }
 
@@ -664,6 +707,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         AddToSpends(hash);
+        AddToWalletUnspent(mapWallet[hash]);
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -714,12 +758,23 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
                         wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            AddToWalletUnspent(wtx);
+
+            // Work out the rounds of our denominated outputs while the inputs are at hand
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                if (IsMine(wtx.vout[i]) && IsDenominatedAmount(wtx.vout[i].nValue))
+                    GetRealInputObfuscationRounds(CTxIn(hash, i), 0);
+            }
+            WriteObfuscationRounds();
         }
 
         bool fUpdated = false;
         if (!fInsertedNew) {
             // Merge
             if (wtxIn.hashBlock != 0 && wtxIn.hashBlock != wtx.hashBlock) {
+                // Moved to another block in a reorg
+                if (wtx.hashBlock != 0)
+                    EraseObfuscationRounds(hash);
                 wtx.hashBlock = wtxIn.hashBlock;
                 fUpdated = true;
             }
@@ -783,6 +838,9 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
+    if (tx.IsZerocoinSpend())
+        NotifyZerocoinSpends(tx);
+
     LOCK2(cs_main, cs_wallet);
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
@@ -791,8 +849,143 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     // available of the outputs it spends. So force those to be
     // recomputed, also:
     BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        if (!tx.IsZerocoinSpend() && mapWallet.count(txin.prevout.hash))
-            mapWallet[txin.prevout.hash].MarkDirty();
+        if (!tx.IsZerocoinSpend() && mapWallet.count(txin.prevout.hash)) {
+            CWalletTx& wtxPrev = mapWallet[txin.prevout.hash];
+            wtxPrev.MarkDirty();
+            // Back into the unspent set when tx left the chain, out once all outputs are spent in it
+            AddToWalletUnspent(wtxPrev);
+            UpdateWalletUnspent(txin.prevout.hash);
+        }
+    }
+}
+
+static uint256 GetMintSerialHash(const CBigNum& bnSerial)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << bnSerial;
+    return Hash(ss.begin(), ss.end());
+}
+
+void CWallet::LoadMintSerials()
+{
+    std::list<CBigNum> listSerials = CWalletDB(strWalletFile).ListMintedCoinsSerial();
+
+    LOCK(cs_mintSerials);
+    setMintSerialHashes.clear();
+    for (const CBigNum& bnSerial : listSerials)
+        setMintSerialHashes.insert(GetMintSerialHash(bnSerial));
+}
+
+void CWallet::UpdateMintSerial(const CZerocoinMint& mint, bool fErased)
+{
+    if (mint.GetSerialNumber() == 0)
+        return;
+
+    LOCK(cs_mintSerials);
+    if (fErased || mint.IsUsed())
+        setMintSerialHashes.erase(GetMintSerialHash(mint.GetSerialNumber()));
+    else
+        setMintSerialHashes.insert(GetMintSerialHash(mint.GetSerialNumber()));
+}
+
+bool CWallet::IsMintSerial(const CBigNum& bnSerial) const
+{
+    LOCK(cs_mintSerials);
+    return setMintSerialHashes.count(GetMintSerialHash(bnSerial)) > 0;
+}
+
+void CWallet::NotifyZerocoinSpends(const CTransaction& tx)
+{
+    {
+        LOCK(cs_mintSerials);
+        if (setMintSerialHashes.empty())
+            return;
+    }
+
+    for (const CTxIn& txin : tx.vin) {
+        if (!txin.scriptSig.IsZerocoinSpend())
+            continue;
+
+        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
+        if (IsMintSerial(spend.getCoinSerialNumber())) {
+            LogPrintf("%s: %s detected spent zerocoin mint in transaction %s \n", __func__, spend.getCoinSerialNumber().GetHex(), tx.GetHash().GetHex());
+            NotifyZerocoinChanged(this, spend.getCoinSerialNumber().GetHex(), "Used", CT_UPDATED);
+        }
+    }
+}
+
+static boost::mutex csWitnessUpdate;
+static boost::condition_variable condWitnessUpdate;
+static bool fWitnessUpdate = false;
+
+void CWallet::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    //accumulator witnesses only move forward when a new accumulator checkpoint is generated,
+    //which may be on any of the blocks connected since the last call
+    if (pindex->nAccumulatorCheckpoint == nWitnessCheckpointLast)
+        return;
+    nWitnessCheckpointLast = pindex->nAccumulatorCheckpoint;
+
+    {
+        boost::unique_lock<boost::mutex> lock(csWitnessUpdate);
+        fWitnessUpdate = true;
+    }
+    condWitnessUpdate.notify_one();
+}
+
+void ThreadUpdateAccumulatorWitnesses(CWallet* pwallet)
+{
+    RenameThread("BitMoney-witness");
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(csWitnessUpdate);
+            while (!fWitnessUpdate)
+                condWitnessUpdate.wait(lock);
+            fWitnessUpdate = false;
+        }
+        pwallet->UpdateAccumulatorWitnesses();
+    }
+}
+
+void CWallet::UpdateAccumulatorWitnesses()
+{
+    if (!fFileBacked || chainActive.Height() < Params().Zerocoin_StartHeight())
+        return;
+
+    CWalletDB walletdb(strWalletFile);
+    std::list<CZerocoinMint> listMints;
+    {
+        LOCK(cs_wallet);
+        listMints = walletdb.ListMintedCoins(true, true, false);
+    }
+
+    //advance each witness in steps, so that cs_main is never held for more than WITNESS_ADVANCE_BLOCKS blocks
+    std::set<CBigNum> setUnspent;
+    for (const CZerocoinMint& mint : listMints) {
+        setUnspent.insert(mint.GetValue());
+        libzerocoin::PublicCoin pubcoin(Params().Zerocoin_Params(), mint.GetValue(), mint.GetDenomination());
+        while (true) {
+            boost::this_thread::interruption_point();
+            LOCK2(cs_main, cs_wallet);
+            CAccumulatorWitnessData& witnessData = mapAccumulatorWitnesses[mint.GetValue()];
+            int nHeightBefore = witnessData.vCheckpoints.empty() ? -1 : witnessData.vCheckpoints.back().nHeight;
+            if (!AdvanceAccumulatorWitness(pubcoin, witnessData, WITNESS_ADVANCE_BLOCKS))
+                break;
+            walletdb.WriteAccumulatorWitness(witnessData);
+            if (witnessData.vCheckpoints.empty() || witnessData.vCheckpoints.back().nHeight == nHeightBefore)
+                break;
+        }
+    }
+
+    //forget the witnesses of mints that were spent or could not be located in the chain
+    LOCK(cs_wallet);
+    for (auto it = mapAccumulatorWitnesses.begin(); it != mapAccumulatorWitnesses.end();) {
+        if (setUnspent.count(it->first) && !it->second.IsNull()) {
+            ++it;
+            continue;
+        }
+        walletdb.EraseAccumulatorWitness(it->first);
+        mapAccumulatorWitnesses.erase(it++);
     }
 }
 
@@ -802,6 +995,8 @@ void CWallet::EraseFromWallet(const uint256& hash)
         return;
     {
         LOCK(cs_wallet);
+        mapWalletUnspent.erase(hash);
+        EraseObfuscationRounds(hash);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
     }
@@ -843,11 +1038,58 @@ CAmount CWallet::GetDebit(const CTxIn& txin, const isminefilter& filter) const
     return 0;
 }
 
+int CWallet::SetObfuscationRounds(const COutPoint& outpoint, int nRounds) const
+{
+    mapObfuscationRounds[outpoint] = nRounds;
+    setObfuscationRoundsUnsaved.insert(outpoint);
+    LogPrint("obfuscation", "GetInputObfuscationRounds UPDATED   %s %3d %3d\n", outpoint.hash.ToString(), outpoint.n, nRounds);
+    return nRounds;
+}
+
+// Persist the rounds computed since the last call in one database transaction
+void CWallet::WriteObfuscationRounds()
+{
+    if (setObfuscationRoundsUnsaved.empty())
+        return;
+
+    if (fFileBacked) {
+        CWalletDB walletdb(strWalletFile);
+        walletdb.TxnBegin();
+        BOOST_FOREACH (const COutPoint& outpoint, setObfuscationRoundsUnsaved) {
+            std::map<COutPoint, int8_t>::const_iterator it = mapObfuscationRounds.find(outpoint);
+            if (it != mapObfuscationRounds.end())
+                walletdb.WriteObfuscationRounds(outpoint, it->second);
+        }
+        if (!walletdb.TxnCommit())
+            LogPrintf("%s : failed to write obfuscation rounds\n", __func__);
+    }
+    setObfuscationRoundsUnsaved.clear();
+}
+
+void CWallet::LoadObfuscationRounds(const COutPoint& outpoint, int nRounds)
+{
+    mapObfuscationRounds[outpoint] = nRounds;
+}
+
+void CWallet::EraseObfuscationRounds(const uint256& hash)
+{
+    std::map<COutPoint, int8_t>::iterator it = mapObfuscationRounds.lower_bound(COutPoint(hash, 0));
+    if (it == mapObfuscationRounds.end() || it->first.hash != hash)
+        return;
+
+    CWalletDB* pwalletdb = fFileBacked ? new CWalletDB(strWalletFile) : NULL;
+    while (it != mapObfuscationRounds.end() && it->first.hash == hash) {
+        // Unsaved entries have no record yet
+        if (!setObfuscationRoundsUnsaved.erase(it->first) && pwalletdb)
+            pwalletdb->EraseObfuscationRounds(it->first);
+        mapObfuscationRounds.erase(it++);
+    }
+    delete pwalletdb;
+}
+
 // Recursively determine the rounds of a given input (How deep is the Obfuscation chain for a given input)
 int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
-
     if (rounds >= 16) return 15; // 16 rounds max
 
     uint256 hash = in.prevout.hash;
@@ -855,17 +1097,10 @@ int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
 
     const CWalletTx* wtx = GetWalletTx(hash);
     if (wtx != NULL) {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        // not known yet, let's add it
-        if (mdwi == mDenomWtxes.end()) {
-            LogPrint("obfuscation", "GetInputObfuscationRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        }
-        // found and it's not an initial value, just return it
-        else if (mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
+        // already known, just return it
+        std::map<COutPoint, int8_t>::const_iterator mi = mapObfuscationRounds.find(in.prevout);
+        if (mi != mapObfuscationRounds.end())
+            return mi->second;
 
         // bounds check
         if (nout >= wtx->vout.size()) {
@@ -874,30 +1109,20 @@ int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
             return -4;
         }
 
-        if (pwalletMain->IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("obfuscation", "GetInputObfuscationRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+        if (pwalletMain->IsCollateralAmount(wtx->vout[nout].nValue))
+            return SetObfuscationRounds(in.prevout, -3);
 
         //make sure the final output is non-denominate
         if (/*rounds == 0 && */ !IsDenominatedAmount(wtx->vout[nout].nValue)) //NOT DENOM
-        {
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("obfuscation", "GetInputObfuscationRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            return SetObfuscationRounds(in.prevout, -2);
 
         bool fAllDenoms = true;
         BOOST_FOREACH (CTxOut out, wtx->vout) {
             fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
         }
         // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("obfuscation", "GetInputObfuscationRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+        if (!fAllDenoms)
+            return SetObfuscationRounds(in.prevout, 0);
 
         int nShortest = -10; // an initial value, should be no way to get this by calculations
         bool fDenomFound = false;
@@ -912,11 +1137,9 @@ int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
                 }
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                                                             :
-                                                             0; // too bad, we are the fist one in that chain
-        LogPrint("obfuscation", "GetInputObfuscationRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+        return SetObfuscationRounds(in.prevout, fDenomFound ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                                                            :
+                                                            0); // too bad, we are the fist one in that chain
     }
 
     return rounds - 1;
@@ -1274,8 +1497,8 @@ CAmount CWallet::GetBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -1358,8 +1581,8 @@ CAmount CWallet::GetUnlockedCoins() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
                 nTotal += pcoin->GetUnlockedCredit();
@@ -1376,8 +1599,8 @@ CAmount CWallet::GetLockedCoins() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             if (pcoin->IsTrusted() && pcoin->GetDepthInMainChain() > 0)
                 nTotal += pcoin->GetLockedCredit();
@@ -1410,8 +1633,8 @@ CAmount CWallet::GetAnonymizableBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizableCredit();
@@ -1428,8 +1651,8 @@ CAmount CWallet::GetAnonymizedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizedCredit();
@@ -1450,8 +1673,8 @@ double CWallet::GetAverageAnonymizedRounds() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             uint256 hash = (*it).first;
 
@@ -1482,8 +1705,8 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             uint256 hash = (*it).first;
 
@@ -1509,8 +1732,8 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
 
             nTotal += pcoin->GetDenominatedCredit(unconfirmed);
         }
@@ -1524,8 +1747,8 @@ CAmount CWallet::GetUnconfirmedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -1538,8 +1761,8 @@ CAmount CWallet::GetImmatureBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             nTotal += pcoin->GetImmatureCredit();
         }
     }
@@ -1551,8 +1774,8 @@ CAmount CWallet::GetWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -1566,8 +1789,8 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -1580,8 +1803,8 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             nTotal += pcoin->GetImmatureWatchOnlyCredit();
         }
     }
@@ -1597,9 +1820,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
             const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            const CWalletTx* pcoin = it->second;
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -2150,8 +2373,8 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
     CAmount nTotal = 0;
     {
         LOCK(cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        for (map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx* pcoin = it->second;
             if (pcoin->IsTrusted()) {
                 int nDepth = pcoin->GetDepthInMainChain(false);
 
@@ -2543,8 +2766,14 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     static std::set<pair<const CWalletTx*, unsigned int> > setStakeCoins;
     static int nLastStakeSetUpdate = 0;
 
+    // Kernel candidates for setStakeCoins, rebuilt when the set or the tip changes
+    static std::vector<CStakeKernelCandidate> vStakeCandidates;
+    static std::vector<pair<const CWalletTx*, unsigned int> > vStakeCandidateCoins;
+    static uint256 hashStakeCandidatesTip = 0;
+
     if (GetTime() - nLastStakeSetUpdate > nStakeSetUpdateTime) {
         setStakeCoins.clear();
+        hashStakeCandidatesTip = 0;
         if (!SelectStakeCoins(setStakeCoins, nBalance - nReserveBalance))
             return false;
 
@@ -2554,96 +2783,93 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (setStakeCoins.empty())
         return false;
 
+    {
+        LOCK(cs_main);
+        if (hashStakeCandidatesTip != chainActive.Tip()->GetBlockHash()) {
+            vStakeCandidates.clear();
+            vStakeCandidateCoins.clear();
+            BOOST_FOREACH (PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setStakeCoins) {
+                BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
+                if (it == mapBlockIndex.end()) {
+                    if (fDebug)
+                        LogPrintf("CreateCoinStake() failed to find block index \n");
+                    continue;
+                }
+
+                CStakeKernelCandidate candidate;
+                if (!GetStakeKernelCandidate(it->second, COutPoint(pcoin.first->GetHash(), pcoin.second), pcoin.first->vout[pcoin.second].nValue, candidate))
+                    continue;
+                vStakeCandidates.push_back(candidate);
+                vStakeCandidateCoins.push_back(pcoin);
+            }
+            hashStakeCandidatesTip = chainActive.Tip()->GetBlockHash();
+        }
+    }
+
     vector<const CWalletTx*> vwtxPrev;
 
     CAmount nCredit = 0;
     CScript scriptPubKeyKernel;
 
-    //prevent staking a time that won't be accepted
-    if (GetAdjustedTime() <= chainActive.Tip()->nTime)
-        MilliSleep(10000);
-
-    BOOST_FOREACH (PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setStakeCoins) {
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = NULL;
-        BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
-        if (it != mapBlockIndex.end())
-            pindex = it->second;
-        else {
-            if (fDebug)
-                LogPrintf("CreateCoinStake() failed to find block index \n");
-            continue;
+    //prevent staking a time that won't be accepted, waiting no longer than needed
+    int64_t nTimeTip = chainActive.Tip()->nTime;
+    if (GetAdjustedTime() <= nTimeTip)
+        MilliSleep((nTimeTip - GetAdjustedTime() + 1) * 1000);
+
+    nTxNewTime = GetAdjustedTime();
+    size_t nFound = 0;
+    uint256 hashProofOfStake = 0;
+    if (FindStakeKernel(vStakeCandidates, nBits, nTxNewTime, nHashDrift, chainActive.Tip()->GetMedianTimePast(), nFound, hashProofOfStake)) {
+        const PAIRTYPE(const CWalletTx*, unsigned int)& pcoin = vStakeCandidateCoins[nFound];
+
+        // Found a kernel
+        if (fDebug && GetBoolArg("-printcoinstake", false))
+            LogPrintf("CreateCoinStake : kernel found\n");
+
+        vector<valtype> vSolutions;
+        txnouttype whichType;
+        CScript scriptPubKeyOut;
+        scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
+        if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
+            LogPrintf("CreateCoinStake : failed to parse kernel\n");
+            return false;
         }
-
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
-
-        bool fKernelFound = false;
-        uint256 hashProofOfStake = 0;
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-
-        //iterates each utxo inside of CheckStakeKernelHash()
-        if (CheckStakeKernelHash(nBits, block, *pcoin.first, prevoutStake, nTxNewTime, nHashDrift, false, hashProofOfStake, true)) {
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
-
-            // Found a kernel
+        if (fDebug && GetBoolArg("-printcoinstake", false))
+            LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
+        if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
             if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : kernel found\n");
-
-            vector<valtype> vSolutions;
-            txnouttype whichType;
-            CScript scriptPubKeyOut;
-            scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
-            if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
-                LogPrintf("CreateCoinStake : failed to parse kernel\n");
-                break;
-            }
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
-            if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
+                LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
+            return false; // only support pay to public key and pay to address
+        }
+        if (whichType == TX_PUBKEYHASH) // pay to address type
+        {
+            //convert to pay to public key type
+            CKey key;
+            if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
                 if (fDebug && GetBoolArg("-printcoinstake", false))
-                    LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
-                break; // only support pay to public key and pay to address
+                    LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
+                return false; // unable to find corresponding public key
             }
-            if (whichType == TX_PUBKEYHASH) // pay to address type
-            {
-                //convert to pay to public key type
-                CKey key;
-                if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
-                    if (fDebug && GetBoolArg("-printcoinstake", false))
-                        LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
-                    break; // unable to find corresponding public key
-                }
 
-                scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
-            } else
-                scriptPubKeyOut = scriptPubKeyKernel;
+            scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
+        } else
+            scriptPubKeyOut = scriptPubKeyKernel;
 
-            txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-            nCredit += pcoin.first->vout[pcoin.second].nValue;
-            vwtxPrev.push_back(pcoin.first);
-            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+        txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
+        nCredit += pcoin.first->vout[pcoin.second].nValue;
+        vwtxPrev.push_back(pcoin.first);
+        txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
 
-            //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
-            const CBlockIndex* pIndex0 = chainActive.Tip();
-            uint64_t nTotalSize = pcoin.first->vout[pcoin.second].nValue + GetBlockValue(pIndex0->nHeight);
+        //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
+        const CBlockIndex* pIndex0 = chainActive.Tip();
+        uint64_t nTotalSize = pcoin.first->vout[pcoin.second].nValue + GetBlockValue(pIndex0->nHeight);
 
-            //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
-            if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
-                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+        //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
+        if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
+            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
 
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
-            fKernelFound = true;
-            break;
-        }
-        if (fKernelFound)
-            break; // if kernel is found stop searching
+        if (fDebug && GetBoolArg("-printcoinstake", false))
+            LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
     }
     if (nCredit == 0 || nCredit > nBalance - nReserveBalance)
         return false;
@@ -2940,6 +3166,29 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         return nLoadWalletRet;
     fFirstRunRet = !vchDefaultKey.IsValid();
 
+    {
+        // Loading added every transaction with an output of ours, drop those spent in the chain
+        LOCK2(cs_main, cs_wallet);
+        std::vector<uint256> vHashes;
+        for (std::map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it)
+            vHashes.push_back(it->first);
+        BOOST_FOREACH (const uint256& hash, vHashes)
+            UpdateWalletUnspent(hash);
+        LogPrintf("%s : %u of %u wallet transactions hold unspent outputs\n", __func__, mapWalletUnspent.size(), mapWallet.size());
+
+        // Rounds of unspent denominated outputs the wallet file has no record of yet, saved together
+        for (std::map<uint256, const CWalletTx*>::const_iterator it = mapWalletUnspent.begin(); it != mapWalletUnspent.end(); ++it) {
+            const CWalletTx& wtx = *it->second;
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                if (IsMine(wtx.vout[i]) && IsDenominatedAmount(wtx.vout[i].nValue))
+                    GetRealInputObfuscationRounds(CTxIn(it->first, i), 0);
+            }
+        }
+        WriteObfuscationRounds();
+    }
+
+    LoadMintSerials();
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -4078,7 +4327,11 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
     libzerocoin::AccumulatorWitness witness(Params().Zerocoin_Params(), accumulator, pubCoinSelected);
     string strFailReason = "";
     int nMintsAdded = 0;
-    if (!GenerateAccumulatorWitness(pubCoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason)) {
+    CAccumulatorWitnessData& witnessData = mapAccumulatorWitnesses[pubCoinSelected.getValue()];
+    bool fWitness = GenerateAccumulatorWitness(pubCoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason, &witnessData);
+    if (!witnessData.IsNull())
+        CWalletDB(strWalletFile).WriteAccumulatorWitness(witnessData);
+    if (!fWitness) {
         receipt.SetStatus("Try to spend with a higher security level to include more coins", ZBitMoney_FAILED_ACCUMULATOR_INITIALIZATION);
         LogPrintf("%s : %s \n", __func__, receipt.GetStatusMessage());
         return false;
@@ -4136,6 +4389,7 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
                 zerocoinSelected.SetUsed(true);
                 if (!CWalletDB(strWalletFile).WriteZerocoinMint(zerocoinSelected))
                     LogPrintf("%s failed to write zerocoinmint\n", __func__);
+                UpdateMintSerial(zerocoinSelected, false);
 
                 pwalletMain->NotifyZerocoinChanged(pwalletMain, zerocoinSelected.GetValue().GetHex(), "Used", CT_UPDATED);
                 receipt.SetStatus("the coin spend has been used", ZBitMoney_SPENT_USED_ZBitMoney);
@@ -4215,6 +4469,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
 
             mint.SetUsed(true);
             walletdb.WriteZerocoinMint(mint);
+            UpdateMintSerial(mint, false);
 
             return false;
         }
@@ -4234,6 +4489,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
         // archive this mint as an orphan
         if (fArchive) {
             walletdb.ArchiveMintOrphan(mint);
+            UpdateMintSerial(mint, true);
             nArchived++;
         }
     }
@@ -4362,12 +4618,14 @@ string CWallet::ResetMintZerocoin(bool fExtendedSearch)
     for (CZerocoinMint mint : vMintsToUpdate) {
         updates++;
         walletdb.WriteZerocoinMint(mint);
+        UpdateMintSerial(mint, false);
     }
 
     // Delete any mints that were unable to be located on the blockchain
     for (CZerocoinMint mint : vMintsMissing) {
         deletions++;
         walletdb.ArchiveMintOrphan(mint);
+        UpdateMintSerial(mint, true);
     }
 
     string strResult = _("ResetMintZerocoin finished: ") + to_string(updates) + _(" mints updated, ") + to_string(deletions) + _(" mints deleted\n");
@@ -4403,6 +4661,7 @@ string CWallet::ResetSpentZerocoin()
                 mint.SetUsed(false);
                 RemoveSerialFromDB(spend.GetSerial());
                 walletdb.WriteZerocoinMint(mint);
+                UpdateMintSerial(mint, false);
                 walletdb.EraseZerocoinSpendSerialEntry(spend.GetSerial());
                 continue;
             }
@@ -4439,6 +4698,7 @@ void CWallet::ReconsiderZerocoins(std::list<CZerocoinMint>& listMintsRestored)
         if (!walletdb.UnarchiveZerocoin(mint)) {
             LogPrintf("%s : failed to unarchive mint %s\n", __func__, mint.GetValue().GetHex());
         }
+        UpdateMintSerial(mint, false);
         listMintsRestored.emplace_back(mint);
     }
 }
@@ -4523,6 +4783,7 @@ string CWallet::MintZerocoin(CAmount nValue, CWalletTx& wtxNew, vector<CZerocoin
         for (CZerocoinMint mint : vMints) {
             mint.SetTxHash(wtxNew.GetHash());
             walletdb.WriteZerocoinMint(mint);
+            UpdateMintSerial(mint, false);
             pwalletMain->NotifyZerocoinChanged(pwalletMain, mint.GetValue().GetHex(), "Used", CT_UPDATED);
         }
     }
@@ -4562,6 +4823,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
         for (CZerocoinMint mint : vMintsSelected) {
             mint.SetUsed(false); // having error, so set to false, to be able to use again
             walletdb.WriteZerocoinMint(mint);
+            UpdateMintSerial(mint, false);
             pwalletMain->NotifyZerocoinChanged(pwalletMain, mint.GetValue().GetHex(), "New", CT_UPDATED);
         }
 
@@ -4577,6 +4839,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
 
         // erase new mints
         for (auto& mint : vNewMints) {
+            UpdateMintSerial(mint, true);
             if (!walletdb.EraseZerocoinMint(mint)) {
                 receipt.SetStatus("Error: Unable to cannot delete zerocoin mint in wallet", ZBitMoney_ERASE_NEW_MINTS_FAILED);
             }
@@ -4592,6 +4855,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
             receipt.SetStatus("Failed to write mint to db", nStatus);
             return false;
         }
+        UpdateMintSerial(mint, false);
 
         CZerocoinMint mintCheck;
         if (!walletdb.ReadZerocoinMint(mint.GetValue(), mintCheck)) {
@@ -4609,6 +4873,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
     for (CZerocoinMint mint : vNewMints) {
         mint.SetTxHash(wtxNew.GetHash());
         walletdb.WriteZerocoinMint(mint);
+        UpdateMintSerial(mint, false);
     }
 
     receipt.SetStatus("Spend Successful", ZBitMoney_SPEND_OKAY);  // When we reach this point spending zBIT was successful
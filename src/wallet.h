@@ -8,6 +8,7 @@
 #ifndef BITCOIN_WALLET_H
 #define BITCOIN_WALLET_H
 
+#include "accumulators.h"
 #include "amount.h"
 #include "base58.h"
 #include "crypter.h"
@@ -33,6 +34,8 @@
 #include <utility>
 #include <vector>
 
+#include <boost/unordered_set.hpp>
+
 /**
  * Settings
  */
@@ -58,14 +61,20 @@ static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 // Zerocoin denomination which creates exactly one of each denominations:
 // 6666 = 1*5000 + 1*1000 + 1*500 + 1*100 + 1*50 + 1*10 + 1*5 + 1
 static const int ZQ_6666 = 6666;
+//! Blocks an accumulator witness is advanced by per cs_main lock in UpdateAccumulatorWitnesses
+static const int WITNESS_ADVANCE_BLOCKS = 100;
 
 class CAccountingEntry;
 class CCoinControl;
 class COutput;
 class CReserveKey;
 class CScript;
+class CWallet;
 class CWalletTx;
 
+//! Advances the accumulator witnesses of pwallet whenever a new accumulator checkpoint connects
+void ThreadUpdateAccumulatorWitnesses(CWallet* pwallet);
+
 /** (client) version numbers for particular wallet features */
 enum WalletFeature {
     FEATURE_BASE = 10500, // the earliest version new wallets supports (only useful for getinfo's clientversion output)
@@ -185,6 +194,22 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    bool IsSpentInMainChain(const uint256& hash, unsigned int n) const;
+    void AddToWalletUnspent(const CWalletTx& wtx);
+    void UpdateWalletUnspent(const uint256& hash);
+
+    /**
+     * Obfuscation rounds of our outputs, see GetRealInputObfuscationRounds(). Entries are
+     * computed once, kept in the wallet file as "obfsrounds" records and dropped when their
+     * transaction is erased or moves to another block.
+     */
+    mutable std::map<COutPoint, int8_t> mapObfuscationRounds;
+    //! Entries of mapObfuscationRounds not written to the wallet file yet, see WriteObfuscationRounds()
+    mutable std::set<COutPoint> setObfuscationRoundsUnsaved;
+    int SetObfuscationRounds(const COutPoint& outpoint, int nRounds) const;
+    void EraseObfuscationRounds(const uint256& hash);
+    void WriteObfuscationRounds();
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount) const;
@@ -327,6 +352,24 @@ public:
 
     std::map<uint256, CWalletTx> mapWallet;
 
+    /**
+     * The wallet transactions that may still hold unspent outputs of ours: every other
+     * transaction only has outputs that are not ours or are spent by a wallet transaction
+     * confirmed in the active chain. Balances and AvailableCoins only look at these.
+     * Entries are added on AddToWallet and MarkDirty and dropped when SyncTransaction or
+     * MarkDirty sees the last output spent; a reorg brings them back through SyncTransaction.
+     */
+    std::map<uint256, const CWalletTx*> mapWalletUnspent;
+
+    //! Persistent accumulator witnesses of the unspent zerocoin mints, keyed by pubcoin value
+    std::map<CBigNum, CAccumulatorWitnessData> mapAccumulatorWitnesses;
+    //! Accumulator checkpoint of the tip the witnesses were last scheduled to advance to
+    uint256 nWitnessCheckpointLast;
+
+    //! Hashes of the serials of the unspent zerocoin mints, updated by every CWallet path that writes, erases or archives a mint
+    mutable CCriticalSection cs_mintSerials;
+    boost::unordered_set<uint256, CCoinsKeyHasher> setMintSerialHashes;
+
     int64_t nOrderPosNext;
     std::map<uint256, int> mapRequestCount;
 
@@ -400,6 +443,9 @@ public:
     //! Look up a destination data tuple in the store, return true if found false otherwise
     bool GetDestData(const CTxDestination& dest, const std::string& key, std::string* value) const;
 
+    //! Adds the obfuscation rounds of an output, without saving them to disk (used by LoadWallet)
+    void LoadObfuscationRounds(const COutPoint& outpoint, int nRounds);
+
     //! Adds a watch-only address to the store, and saves it to disk.
     bool AddWatchOnly(const CScript& dest);
     bool RemoveWatchOnly(const CScript& dest);
@@ -437,6 +483,12 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+    void UpdateAccumulatorWitnesses();
+    void LoadMintSerials();
+    void UpdateMintSerial(const CZerocoinMint& mint, bool fErased);
+    bool IsMintSerial(const CBigNum& bnSerial) const;
+    void NotifyZerocoinSpends(const CTransaction& tx);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
@@ -648,6 +648,18 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             ssValue >> pSettings;
             pwallet->fCombineDust = pSettings.first;
             pwallet->nAutoCombineThreshold = pSettings.second;
+        } else if (strType == "zcwitness") {
+            uint256 hash;
+            ssKey >> hash;
+            CAccumulatorWitnessData witnessData;
+            ssValue >> witnessData;
+            pwallet->mapAccumulatorWitnesses[witnessData.bnPubcoin] = witnessData;
+        } else if (strType == "obfsrounds") {
+            COutPoint outpoint;
+            ssKey >> outpoint;
+            int8_t nRounds;
+            ssValue >> nRounds;
+            pwallet->LoadObfuscationRounds(outpoint, nRounds);
         } else if (strType == "destdata") {
             std::string strAddress, strKey, strValue;
             ssKey >> strAddress;
@@ -1041,6 +1053,36 @@ bool CWalletDB::ReadZerocoinSpendSerialEntry(const CBigNum& bnSerial)
     return Read(make_pair(string("zcserial"), bnSerial), spend);
 }
 
+bool CWalletDB::WriteObfuscationRounds(const COutPoint& outpoint, int nRounds)
+{
+    nWalletDBUpdated++;
+    return Write(make_pair(string("obfsrounds"), outpoint), (int8_t)nRounds);
+}
+
+bool CWalletDB::EraseObfuscationRounds(const COutPoint& outpoint)
+{
+    nWalletDBUpdated++;
+    return Erase(make_pair(string("obfsrounds"), outpoint));
+}
+
+bool CWalletDB::WriteAccumulatorWitness(const CAccumulatorWitnessData& witnessData)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << witnessData.bnPubcoin;
+    uint256 hash = Hash(ss.begin(), ss.end());
+
+    return Write(make_pair(string("zcwitness"), hash), witnessData, true);
+}
+
+bool CWalletDB::EraseAccumulatorWitness(const CBigNum& bnPubcoin)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << bnPubcoin;
+    uint256 hash = Hash(ss.begin(), ss.end());
+
+    return Erase(make_pair(string("zcwitness"), hash));
+}
+
 bool CWalletDB::WriteZerocoinMint(const CZerocoinMint& zerocoinMint)
 {
     CDataStream ss(SER_GETHASH, 0);
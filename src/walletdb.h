@@ -31,6 +31,7 @@ class CMasterKey;
 class CScript;
 class CWallet;
 class CWalletTx;
+class CAccumulatorWitnessData;
 class CZerocoinMint;
 class CZerocoinSpend;
 class uint160;
@@ -163,6 +164,11 @@ public:
     bool WriteZerocoinSpendSerialEntry(const CZerocoinSpend& zerocoinSpend);
     bool EraseZerocoinSpendSerialEntry(const CBigNum& serialEntry);
     bool ReadZerocoinSpendSerialEntry(const CBigNum& bnSerial);
+    bool WriteObfuscationRounds(const COutPoint& outpoint, int nRounds);
+    bool EraseObfuscationRounds(const COutPoint& outpoint);
+
+    bool WriteAccumulatorWitness(const CAccumulatorWitnessData& witnessData);
+    bool EraseAccumulatorWitness(const CBigNum& bnPubcoin);
 
 private:
     CWalletDB(const CWalletDB&);